@@ -1,21 +1,37 @@
 from chiavdf._chiavdf import (
+    b_cache_size,
     bqfc_deserialize,
+    clear_b_cache,
+    clear_verifier_cache,
     create_discriminant,
     create_discriminant_and_verify_n_wesolowski,
     get_b_from_n_wesolowski,
     prove,
+    set_b_cache_capacity,
+    set_verifier_cache_capacity,
+    verifier_cache_size,
     verify_n_wesolowski,
+    verify_n_wesolowski_batch,
+    verify_n_wesolowski_parallel,
     verify_n_wesolowski_with_b,
     verify_wesolowski,
 )
 
 __all__ = [
+    "b_cache_size",
     "bqfc_deserialize",
+    "clear_b_cache",
+    "clear_verifier_cache",
     "create_discriminant",
     "create_discriminant_and_verify_n_wesolowski",
     "get_b_from_n_wesolowski",
     "prove",
+    "set_b_cache_capacity",
+    "set_verifier_cache_capacity",
+    "verifier_cache_size",
     "verify_n_wesolowski",
+    "verify_n_wesolowski_batch",
+    "verify_n_wesolowski_parallel",
     "verify_n_wesolowski_with_b",
     "verify_wesolowski",
 ]
@@ -1,15 +1,23 @@
 __all__ = [
+    "b_cache_size",
     "bqfc_deserialize",
+    "clear_b_cache",
+    "clear_verifier_cache",
     "create_discriminant",
     "create_discriminant_and_verify_n_wesolowski",
     "get_b_from_n_wesolowski",
     "prove",
+    "set_b_cache_capacity",
+    "set_verifier_cache_capacity",
+    "verifier_cache_size",
     "verify_n_wesolowski",
+    "verify_n_wesolowski_batch",
+    "verify_n_wesolowski_parallel",
     "verify_n_wesolowski_with_b",
     "verify_wesolowski",
 ]
 
-def create_discriminant(challenge_hash: bytes, discriminant_size_bits: int) -> str: ...
+def create_discriminant(challenge_hash: bytes, discriminant_size_bits: int, num_threads: int = 1) -> str: ...
 def verify_wesolowski(
     discriminant: str,
     x_s: bytes | str,
@@ -25,6 +33,20 @@ def verify_n_wesolowski(
     disc_size_bits: int,
     recursion: int,
 ) -> bool: ...
+def verify_n_wesolowski_parallel(
+    discriminant: str,
+    x_s: bytes | str,
+    proof_blob: bytes,
+    num_iterations: int,
+    disc_size_bits: int,
+    recursion: int,
+    num_threads: int = 0,
+) -> bool: ...
+def verify_n_wesolowski_batch(
+    discriminant: str,
+    items: list[tuple[bytes | str, bytes, int, int]],
+    disc_size_bits: int,
+) -> list[bool]: ...
 def create_discriminant_and_verify_n_wesolowski(
     challenge_hash: bytes,
     discriminant_size_bits: int,
@@ -39,6 +61,7 @@ def prove(
     discriminant_size_bits: int,
     num_iterations: int,
     shutdown_file_path: str,
+    num_threads: int = 1,
 ) -> bytes: ...
 def verify_n_wesolowski_with_b(
     discriminant: str,
@@ -60,3 +83,9 @@ def get_b_from_n_wesolowski(
     num_iterations: int,
     recursion: int,
 ) -> str: ...
+def set_verifier_cache_capacity(capacity: int) -> None: ...
+def clear_verifier_cache() -> None: ...
+def verifier_cache_size() -> int: ...
+def set_b_cache_capacity(capacity: int) -> None: ...
+def clear_b_cache() -> None: ...
+def b_cache_size() -> int: ...
@@ -45,7 +45,6 @@ int main(int argc, char const* argv[]) try
     form f=form::generator(D);
 
     std::atomic<bool> stopped = false;
-    fast_algorithm = false;
 
     uint64_t iter = iter_multiplier;
     OneWesolowskiCallback weso(D, f, iter);
@@ -52,8 +52,6 @@ int main(int argc, char const* argv[]) try
     integer L=root(-D, 4);
     form f=form::generator(D);
     std::atomic<bool> stopped = false;
-    fast_algorithm = false;
-    two_weso = true;
     TwoWesolowskiCallback weso(D, f);
     FastStorage* fast_storage = NULL;
     std::thread vdf_worker(repeated_square, 0, f, D, L, &weso, fast_storage, std::ref(stopped));
@@ -2,17 +2,372 @@
 #define ALLOC_H
 
 #include <stdlib.h> // for posix_memalign
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include <gmp.h>
 
-inline void* mp_alloc_func(size_t new_bytes)
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+inline void* mp_aligned_malloc(size_t bytes, size_t alignment)
 {
-    new_bytes = ((new_bytes + 8) + 15) & ~15;
 #if defined _MSC_VER
-    uint8_t* ret = static_cast<uint8_t*>(_aligned_malloc(new_bytes, 16));
+    return _aligned_malloc(bytes, alignment);
+#else
+    void* ptr = nullptr;
+    if (::posix_memalign(&ptr, alignment, bytes) != 0) return nullptr;
+    return ptr;
+#endif
+}
+
+inline void mp_aligned_free(void* ptr)
+{
+#if defined _MSC_VER
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+// Optional huge-page backing for the large, long-lived arrays that provers
+// walk in no particular order (checkpoint and intermediate form arrays,
+// GMP limb slabs), to cut TLB misses. Set CHIAVDF_HUGE_PAGES:
+//   unset / "0"  regular allocations
+//   "1"          2 MiB aligned mappings with madvise(MADV_HUGEPAGE), i.e.
+//                transparent huge pages
+//   "hugetlb"    MAP_HUGETLB from the reserved pool (vm.nr_hugepages),
+//                falling back to "1" when the pool is empty
+// Linux only; elsewhere, or if a mapping fails, the regular allocation is
+// used.
+enum class HugePageMode { kOff, kTransparent, kHugetlb };
+
+const size_t kHugePageBytes = size_t(1) << 21;
+
+inline HugePageMode GetHugePageMode() {
+#if defined(__linux__)
+    static const HugePageMode mode = [] {
+        const char* value = getenv("CHIAVDF_HUGE_PAGES");
+        if (value == nullptr || value[0] == '\0' || strcmp(value, "0") == 0 || strcmp(value, "off") == 0)
+            return HugePageMode::kOff;
+        if (strcmp(value, "hugetlb") == 0)
+            return HugePageMode::kHugetlb;
+        return HugePageMode::kTransparent;
+    }();
+    return mode;
+#else
+    return HugePageMode::kOff;
+#endif
+}
+
+// Owns one large allocation, zero-filled if asked for or if it is backed by
+// huge pages.
+class LargeBuffer {
+  public:
+    LargeBuffer() = default;
+
+    LargeBuffer(size_t bytes, bool zeroed, HugePageMode mode = GetHugePageMode()) {
+        Allocate(bytes, zeroed, mode);
+    }
+
+    ~LargeBuffer() {
+        Reset();
+    }
+
+    LargeBuffer(LargeBuffer&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    LargeBuffer& operator=(LargeBuffer&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            std::swap(ptr, other.ptr);
+            std::swap(mapped_bytes, other.mapped_bytes);
+        }
+        return *this;
+    }
+
+    LargeBuffer(const LargeBuffer&) = delete;
+    LargeBuffer& operator=(const LargeBuffer&) = delete;
+
+    // Throws std::bad_alloc if even the regular allocation fails.
+    void Allocate(size_t bytes, bool zeroed, HugePageMode mode = GetHugePageMode()) {
+        Reset();
+        if (mode != HugePageMode::kOff && bytes >= kHugePageBytes)
+            ptr = MapHugePages(bytes, mode);
+        if (ptr == nullptr) {
+#if defined _MSC_VER
+            ptr = mp_aligned_malloc(bytes, 64);
+            if (ptr != nullptr && zeroed)
+                memset(ptr, 0, bytes);
 #else
+            // calloc leaves untouched pages unmapped.
+            ptr = zeroed ? calloc(bytes, 1) : mp_aligned_malloc(bytes, 64);
+#endif
+        }
+        if (ptr == nullptr && bytes != 0)
+            throw std::bad_alloc();
+    }
+
+    void Reset() {
+#if defined(__linux__)
+        if (mapped_bytes != 0)
+            munmap(ptr, mapped_bytes);
+        else
+#endif
+            mp_aligned_free(ptr);
+        ptr = nullptr;
+        mapped_bytes = 0;
+    }
+
+    void* get() const {
+        return ptr;
+    }
+
+    bool IsHugePageBacked() const {
+        return mapped_bytes != 0;
+    }
+
+  private:
     void* ptr = nullptr;
-    if (::posix_memalign(&ptr, 16, new_bytes) != 0) return nullptr;
-    uint8_t* ret = static_cast<uint8_t*>(ptr);
+    // Nonzero for a huge-page mapping.
+    size_t mapped_bytes = 0;
+
+    void* MapHugePages(size_t bytes, HugePageMode mode) {
+#if defined(__linux__)
+        size_t length = (bytes + kHugePageBytes - 1) & ~(kHugePageBytes - 1);
+#if defined(MAP_HUGETLB)
+        if (mode == HugePageMode::kHugetlb) {
+            void* p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                mapped_bytes = length;
+                return p;
+            }
+        }
 #endif
+        // Transparent huge pages only cover 2 MiB aligned ranges, so map a
+        // page more and trim both ends to alignment.
+        void* raw = mmap(nullptr, length + kHugePageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return nullptr;
+        uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (begin + kHugePageBytes - 1) & ~uintptr_t(kHugePageBytes - 1);
+        if (aligned != begin)
+            munmap(raw, aligned - begin);
+        if (kHugePageBytes != aligned - begin)
+            munmap(reinterpret_cast<void*>(aligned + length), kHugePageBytes - (aligned - begin));
+#if defined(MADV_HUGEPAGE)
+        madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+#endif
+        mapped_bytes = length;
+        return reinterpret_cast<void*>(aligned);
+#else
+        (void)bytes;
+        (void)mode;
+        return nullptr;
+#endif
+    }
+};
+
+// Fixed-size array of default-constructed T in a LargeBuffer; stands in for
+// std::unique_ptr<T[]> for the large form arrays.
+template <class T>
+class LargeArray {
+  public:
+    LargeArray() = default;
+
+    ~LargeArray() {
+        Destroy();
+    }
+
+    LargeArray(const LargeArray&) = delete;
+    LargeArray& operator=(const LargeArray&) = delete;
+
+    void reset(size_t n) {
+        Destroy();
+        buffer.Allocate(n * sizeof(T), /*zeroed=*/false);
+        T* data = get();
+        for (size_t i = 0; i < n; i++)
+            new (data + i) T();
+        count = n;
+    }
+
+    T* get() const {
+        return static_cast<T*>(buffer.get());
+    }
+
+    T& operator[](size_t i) const {
+        return get()[i];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    bool IsHugePageBacked() const {
+        return buffer.IsHugePageBacked();
+    }
+
+  private:
+    LargeBuffer buffer;
+    size_t count = 0;
+
+    void Destroy() {
+        T* data = get();
+        for (size_t i = 0; i < count; i++)
+            data[i].~T();
+        count = 0;
+        buffer.Reset();
+    }
+};
+
+// Slab allocator for GMP limbs, installed per thread with ScopedMpArena.
+// Blocks come in power-of-two size classes carved from 256 KiB chunks (one
+// 2 MiB huge page each with CHIAVDF_HUGE_PAGES) and are recycled through
+// per-class free lists, so a prover's bucket arrays and nucomp temporaries
+// stop going through malloc. Every block keeps the usual
+// 16 + 8 alignment of mp_alloc_func and has a 24-byte header:
+//   ptr - 16: size class, ptr - 8: owning arena.
+// Blocks may be freed from any thread and may outlive the scope; the arena
+// and all its chunks are released in one go once the scope has ended and the
+// last block has been freed.
+class MpArena {
+  public:
+    static const size_t kHeaderBytes = 24;
+    static const int kMinClassLog = 5;   // 32 bytes
+    static const int kMaxClassLog = 14;  // 16 KiB; larger requests use malloc
+    static const size_t kChunkBytes = size_t(1) << 18;
+
+    MpArena() : live(1) {
+        chunk_bytes = GetHugePageMode() == HugePageMode::kOff ? kChunkBytes : kHugePageBytes;
+    }
+
+    MpArena(const MpArena&) = delete;
+    MpArena& operator=(const MpArena&) = delete;
+
+    // Returns nullptr if the request is too large for the arena or a new
+    // chunk cannot be allocated; the caller then falls back to malloc.
+    void* Alloc(size_t bytes) {
+        int cls = kMinClassLog;
+        while ((size_t(1) << cls) < bytes + kHeaderBytes) {
+            if (++cls > kMaxClassLog) return nullptr;
+        }
+        int slot = cls - kMinClassLog;
+
+        uint8_t* block = static_cast<uint8_t*>(free_lists[slot]);
+        if (block == nullptr) {
+            DrainRemoteFrees();
+            block = static_cast<uint8_t*>(free_lists[slot]);
+        }
+        if (block != nullptr) {
+            free_lists[slot] = *reinterpret_cast<void**>(block + kHeaderBytes);
+        } else {
+            size_t size = size_t(1) << cls;
+            if (bump == nullptr || size_t(bump_end - bump) < size) {
+                LargeBuffer chunk;
+                try {
+                    chunk.Allocate(chunk_bytes, /*zeroed=*/false);
+                } catch (const std::bad_alloc&) {
+                    return nullptr;
+                }
+                chunks.push_back(std::move(chunk));
+                bump = static_cast<uint8_t*>(chunks.back().get());
+                bump_end = bump + chunk_bytes;
+            }
+            block = bump;
+            bump += size;
+        }
+
+        reinterpret_cast<uint64_t*>(block)[1] = static_cast<uint64_t>(cls);
+        reinterpret_cast<MpArena**>(block)[2] = this;
+        live.fetch_add(1, std::memory_order_relaxed);
+        return block + kHeaderBytes;
+    }
+
+    // Usable bytes of a block returned by Alloc.
+    static size_t Capacity(void* ptr) {
+        int cls = static_cast<int>(static_cast<uint64_t*>(ptr)[-2]);
+        return (size_t(1) << cls) - kHeaderBytes;
+    }
+
+    static MpArena* Owner(void* ptr) {
+        return static_cast<MpArena**>(ptr)[-1];
+    }
+
+    void Free(void* ptr, MpArena* current) {
+        if (!released.load(std::memory_order_acquire)) {
+            uint8_t* block = static_cast<uint8_t*>(ptr) - kHeaderBytes;
+            int slot = static_cast<int>(static_cast<uint64_t*>(ptr)[-2]) - kMinClassLog;
+            if (current == this) {
+                *static_cast<void**>(ptr) = free_lists[slot];
+                free_lists[slot] = block;
+            } else {
+                std::lock_guard<std::mutex> lk(remote_mutex);
+                *static_cast<void**>(ptr) = remote_lists[slot];
+                remote_lists[slot] = block;
+            }
+        }
+        Unref();
+    }
+
+    // Called when the owning scope ends.
+    void Release() {
+        released.store(true, std::memory_order_release);
+        Unref();
+    }
+
+  private:
+    static const int kNumClasses = kMaxClassLog - kMinClassLog + 1;
+
+    std::atomic<size_t> live;
+    std::atomic<bool> released{false};
+    void* free_lists[kNumClasses] = {};
+    uint8_t* bump = nullptr;
+    uint8_t* bump_end = nullptr;
+    size_t chunk_bytes;
+    std::vector<LargeBuffer> chunks;
+    std::mutex remote_mutex;
+    void* remote_lists[kNumClasses] = {};
+
+    ~MpArena() = default;
+
+    void Unref() {
+        if (live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    // Moves blocks freed by other threads onto the owner's free lists.
+    void DrainRemoteFrees() {
+        std::lock_guard<std::mutex> lk(remote_mutex);
+        for (int slot = 0; slot < kNumClasses; slot++) {
+            while (remote_lists[slot] != nullptr) {
+                uint8_t* block = static_cast<uint8_t*>(remote_lists[slot]);
+                remote_lists[slot] = *reinterpret_cast<void**>(block + kHeaderBytes);
+                *reinterpret_cast<void**>(block + kHeaderBytes) = free_lists[slot];
+                free_lists[slot] = block;
+            }
+        }
+    }
+};
+
+inline thread_local MpArena* mp_current_arena = nullptr;
+
+inline void* mp_alloc_func(size_t new_bytes)
+{
+    if (MpArena* arena = mp_current_arena) {
+        if (void* ret = arena->Alloc(new_bytes)) return ret;
+    }
+    new_bytes = ((new_bytes + 8) + 15) & ~15;
+    uint8_t* ret = static_cast<uint8_t*>(mp_aligned_malloc(new_bytes, 16));
+    if (ret == nullptr) return nullptr;
+    // A null owner in the header marks a plain heap block.
+    *reinterpret_cast<MpArena**>(ret) = nullptr;
     return ret + 8;
 }
 
@@ -20,11 +375,11 @@ inline void mp_free_func(void* old_ptr, size_t) {
     // if the old_ptr alignment is not to 16 bytes + 8 bytes offset, we did not
     // allocate it. It's an in-place buffer and should not be freed
     if ((std::uintptr_t(old_ptr) & 15) == 8) {
-#if defined _MSC_VER
-        _aligned_free(static_cast<uint8_t*>(old_ptr) - 8);
-#else
-        std::free(static_cast<uint8_t*>(old_ptr) - 8);
-#endif
+        if (MpArena* arena = MpArena::Owner(old_ptr)) {
+            arena->Free(old_ptr, mp_current_arena);
+            return;
+        }
+        mp_aligned_free(static_cast<uint8_t*>(old_ptr) - 8);
     }
     else if ((std::uintptr_t(old_ptr) & 63) != 0) {
         // this is a bit mysterious. Our allocator only allocates buffers
@@ -41,6 +396,11 @@ inline void mp_free_func(void* old_ptr, size_t) {
 }
 
 inline void* mp_realloc_func(void* old_ptr, size_t old_size, size_t new_bytes) {
+    // Arena blocks are rounded up to their size class; grow in place if it fits.
+    if ((std::uintptr_t(old_ptr) & 15) == 8 && MpArena::Owner(old_ptr) != nullptr &&
+        new_bytes <= MpArena::Capacity(old_ptr)) {
+        return old_ptr;
+    }
 
     void* ret = mp_alloc_func(new_bytes);
     ::memcpy(ret, old_ptr, std::min(old_size, new_bytes));
@@ -54,4 +414,42 @@ inline void init_gmp() {
     mp_set_memory_functions(mp_alloc_func, mp_realloc_func, mp_free_func);
 }
 
+// Routes this thread's GMP allocations into a fresh MpArena until the scope
+// ends (or Release() is called). A no-op unless init_gmp() installed the
+// functions above, e.g. inside the Python module.
+// Objects that must outlive the scope should be assigned after Release(),
+// otherwise their limbs keep the whole arena alive.
+class ScopedMpArena {
+    MpArena* arena = nullptr;
+    MpArena* prev = nullptr;
+
+  public:
+    ScopedMpArena() {
+        void* (*alloc_func)(size_t);
+        mp_get_memory_functions(&alloc_func, nullptr, nullptr);
+        if (alloc_func != mp_alloc_func) return;
+        arena = new MpArena();
+        prev = mp_current_arena;
+        mp_current_arena = arena;
+    }
+
+    ~ScopedMpArena() {
+        Release();
+    }
+
+    ScopedMpArena(const ScopedMpArena&) = delete;
+    ScopedMpArena& operator=(const ScopedMpArena&) = delete;
+
+    void Release() {
+        if (arena == nullptr) return;
+        mp_current_arena = prev;
+        arena->Release();
+        arena = nullptr;
+    }
+
+    bool IsActive() const {
+        return arena != nullptr;
+    }
+};
+
 #endif
@@ -8,9 +8,13 @@
 extern "C" {
     // C wrapper function
     bool create_discriminant_wrapper(const uint8_t* seed, size_t seed_size, size_t size_bits, uint8_t* result) {
+        return create_discriminant_wrapper_parallel(seed, seed_size, size_bits, result, 1);
+    }
+
+    bool create_discriminant_wrapper_parallel(const uint8_t* seed, size_t seed_size, size_t size_bits, uint8_t* result, uint32_t num_threads) {
         try {
             std::vector<uint8_t> seed_vector(seed, seed + seed_size);
-            integer discriminant = CreateDiscriminant(seed_vector, checked_cast<int>(size_bits));
+            integer discriminant = CreateDiscriminant(seed_vector, checked_cast<int>(size_bits), checked_cast<int>(num_threads));
             mpz_export(result, NULL, 1, 1, 0, 0, discriminant.impl);
             return true;
         } catch (...) {
@@ -19,11 +23,15 @@ extern "C" {
     }
 
     ByteArray prove_wrapper(const uint8_t* challenge_hash, size_t challenge_size, const uint8_t* x_s, size_t x_s_size, size_t discriminant_size_bits, uint64_t num_iterations) {
+        return prove_wrapper_parallel(challenge_hash, challenge_size, x_s, x_s_size, discriminant_size_bits, num_iterations, 1);
+    }
+
+    ByteArray prove_wrapper_parallel(const uint8_t* challenge_hash, size_t challenge_size, const uint8_t* x_s, size_t x_s_size, size_t discriminant_size_bits, uint64_t num_iterations, uint32_t num_threads) {
         try {
             std::vector<uint8_t> challenge_hash_bytes(challenge_hash, challenge_hash + challenge_size);
             integer discriminant = CreateDiscriminant(challenge_hash_bytes, checked_cast<int>(discriminant_size_bits));
             form x = DeserializeForm(discriminant, x_s, x_s_size);
-            std::vector<uint8_t> result = ProveSlow(discriminant, x, num_iterations, "");
+            std::vector<uint8_t> result = ProveSlow(discriminant, x, num_iterations, "", num_threads);
 
             // Allocate memory for the result and copy data
             uint8_t* resultData = new uint8_t[result.size()];
@@ -57,4 +65,28 @@ extern "C" {
     void delete_byte_array(ByteArray array) {
         delete[] array.data;
     }
+
+    void verifier_cache_set_capacity(size_t capacity) {
+        GetVerifierContextCache().SetCapacity(capacity);
+    }
+
+    void verifier_cache_clear(void) {
+        GetVerifierContextCache().Clear();
+    }
+
+    size_t verifier_cache_size(void) {
+        return GetVerifierContextCache().Size();
+    }
+
+    void b_cache_set_capacity(size_t capacity) {
+        GetBCache().SetCapacity(capacity);
+    }
+
+    void b_cache_clear(void) {
+        GetBCache().Clear();
+    }
+
+    size_t b_cache_size(void) {
+        return GetBCache().Size();
+    }
 }
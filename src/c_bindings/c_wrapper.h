@@ -9,6 +9,8 @@ extern "C" {
 #endif
 
 bool create_discriminant_wrapper(const uint8_t* seed, size_t seed_size, size_t size_bits, uint8_t* result);
+// Same as create_discriminant_wrapper, searching on num_threads threads (0 uses every hardware thread, larger counts are capped to it).
+bool create_discriminant_wrapper_parallel(const uint8_t* seed, size_t seed_size, size_t size_bits, uint8_t* result, uint32_t num_threads);
 
 // Define a struct to hold the byte array and its length
 typedef struct {
@@ -16,10 +18,24 @@ typedef struct {
     size_t length;
 } ByteArray;
 ByteArray prove_wrapper(const uint8_t* challenge_hash, size_t challenge_size, const uint8_t* x_s, size_t x_s_size, size_t discriminant_size_bits, uint64_t num_iterations);
+// Same as prove_wrapper, generating the proof on num_threads threads (0 uses every hardware thread).
+ByteArray prove_wrapper_parallel(const uint8_t* challenge_hash, size_t challenge_size, const uint8_t* x_s, size_t x_s_size, size_t discriminant_size_bits, uint64_t num_iterations, uint32_t num_threads);
 
 bool verify_n_wesolowski_wrapper(const uint8_t* discriminant_bytes, size_t discriminant_size, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_size, uint64_t num_iterations, uint64_t recursion);
 void delete_byte_array(ByteArray array);
 
+// Controls for the per-discriminant context cache used by verify_n_wesolowski_wrapper.
+// A capacity of 0 disables caching.
+void verifier_cache_set_capacity(size_t capacity);
+void verifier_cache_clear(void);
+size_t verifier_cache_size(void);
+
+// Controls for the process-wide cache of B values derived from (x, y).
+// A capacity of 0 disables caching.
+void b_cache_set_capacity(size_t capacity);
+void b_cache_clear(void);
+size_t b_cache_size(void);
+
 #ifdef __cplusplus
 }
 #endif
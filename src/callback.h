@@ -3,8 +3,12 @@
 
 #include "util.h"
 #include "nudupl_listener.h"
+#include "checkpoint_store.h"
+#include "compact_form_store.h"
+#include "prover_interface.hpp"
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <limits>
 #include <mutex>
 #include <stdexcept>
@@ -74,9 +78,31 @@ public:
 
     virtual void OnIteration(int type, void *data, uint64_t iteration) = 0;
 
-    std::unique_ptr<form[]> forms;
+    // Advances `iterations` and wakes WaitForIterations callers. Called by
+    // the VDF loop once the forms up to n are stored.
+    void PublishIterations(uint64_t n) {
+        {
+            std::lock_guard<std::mutex> lk(iterations_mutex);
+            iterations = n;
+        }
+        iterations_cv.notify_all();
+    }
+
+    // Blocks until `iterations` reaches target or stop_signal is set;
+    // returns whether target was reached.
+    bool WaitForIterations(uint64_t target, const std::atomic<bool>& stop_signal) {
+        std::unique_lock<std::mutex> lk(iterations_mutex);
+        while (static_cast<uint64_t>(iterations.load()) < target && !stop_signal) {
+            iterations_cv.wait_for(lk, kStopSignalPollInterval);
+        }
+        return static_cast<uint64_t>(iterations.load()) >= target;
+    }
+
+    LargeArray<form> forms;
     size_t forms_capacity = 0;
     std::atomic<int64_t> iterations{0};
+    std::mutex iterations_mutex;
+    std::condition_variable iterations_cv;
     integer D;
     integer L;
     PulmarkReducer* reducer;
@@ -108,7 +134,7 @@ class OneWesolowskiCallback: public WesolowskiCallback {
             throw std::overflow_error("OneWesolowskiCallback forms capacity overflow");
         }
         forms_capacity = static_cast<size_t>(space_needed);
-        forms.reset(new form[forms_capacity]);
+        forms.reset(forms_capacity);
         forms[0] = f;
     }
 
@@ -135,6 +161,11 @@ class OneWesolowskiCallback: public WesolowskiCallback {
     form result;
 };
 
+// The checkpoints form an append-only array: the VDF thread writes each slot
+// once, in order, without taking a lock, and then publishes it by advancing
+// `iterations` after its batch (PublishIterations). Readers load `iterations`
+// first and only copy slots at or below it. A batch that is redone after a
+// corrupted fast step only rewrites slots above the published watermark.
 class TwoWesolowskiCallback: public WesolowskiCallback {
   public:
     TwoWesolowskiCallback(integer& D, const form& f) : WesolowskiCallback(D) {
@@ -143,14 +174,15 @@ class TwoWesolowskiCallback: public WesolowskiCallback {
             (static_cast<uint64_t>(kMaxItersAllowed) - static_cast<uint64_t>(kSwitchIters)) / 100;
         const size_t space_needed = static_cast<size_t>(early_points + late_points);
         forms_capacity = space_needed;
-        forms.reset(new form[space_needed]);
+        forms.reset(space_needed);
         forms[0] = f;
         kl.store(10, std::memory_order_relaxed);
         transition_state.store(EncodeTransitionState(/*switch_index=*/0, /*switch_iters=*/-1), std::memory_order_relaxed);
     }
 
+    // Called from the VDF thread before `iterations` passes num_iters, so
+    // readers that observe the watermark also observe the transition.
     void IncreaseConstants(uint64_t num_iters) {
-        std::lock_guard<std::mutex> lk(forms_mutex);
         // Publish transition metadata first. `kl` is only a fast-path hint.
         transition_state.store(
             EncodeTransitionState(num_iters / 10, static_cast<int64_t>(num_iters)),
@@ -160,7 +192,6 @@ class TwoWesolowskiCallback: public WesolowskiCallback {
     }
 
     size_t GetPosition(uint64_t power) {
-        std::lock_guard<std::mutex> lk(forms_mutex);
         return GetPositionUnlocked(power);
     }
 
@@ -169,12 +200,17 @@ class TwoWesolowskiCallback: public WesolowskiCallback {
         return GetPositionFromSnapshot(power, snapshot);
     }
 
+    // Returns the checkpoint at power, or an empty form if the VDF loop has
+    // not published it yet. Callers wait for `iterations` to reach power.
     form GetFormCopy(uint64_t power) {
-        std::lock_guard<std::mutex> lk(forms_mutex);
+        const int64_t published = iterations.load(std::memory_order_acquire);
         const size_t pos = GetPositionUnlocked(power);
         if (pos >= forms_capacity) {
             throw std::runtime_error("TwoWesolowskiCallback::GetFormCopy out of bounds");
         }
+        if (power > static_cast<uint64_t>(published)) {
+            return form();
+        }
         return forms[pos];
     }
 
@@ -185,13 +221,12 @@ class TwoWesolowskiCallback: public WesolowskiCallback {
 
     void OnIteration(int type, void *data, uint64_t iteration) {
         iteration++;
-        // Most iterations are not checkpoints. Avoid mutex lock/unlock on that hot path.
+        // Most iterations are not checkpoints.
         const uint32_t current_kl = kl.load(std::memory_order_relaxed);
         if (iteration % current_kl != 0) {
             return;
         }
 
-        std::lock_guard<std::mutex> lk(forms_mutex);
         const uint64_t snapshot = transition_state.load(std::memory_order_acquire);
         const uint32_t effective_kl = GetEffectiveKl(iteration, snapshot);
         if (iteration % effective_kl != 0) {
@@ -247,7 +282,6 @@ class TwoWesolowskiCallback: public WesolowskiCallback {
 
     std::atomic<uint64_t> transition_state{0};
     std::atomic<uint32_t> kl{10};
-    std::mutex forms_mutex;
 };
 
 class FastAlgorithmCallback : public WesolowskiCallback {
@@ -273,13 +307,12 @@ class FastAlgorithmCallback : public WesolowskiCallback {
         if (total_forms > static_cast<uint64_t>(std::numeric_limits<size_t>::max())) {
             throw std::overflow_error("FastAlgorithmCallback forms capacity overflow");
         }
-        forms_capacity = static_cast<size_t>(total_forms);
-        forms.reset(new form[forms_capacity]);
-        checkpoints.reset(new form[1 << 18]);
+        intermediates.reset(new CompactFormStore(D, static_cast<size_t>(total_forms)));
+        checkpoints.reset(1 << 18);
 
         y_ret = f;
         for (int i = 0; i < segments; i++)
-            forms[buckets_begin[i]] = f;
+            intermediates->Set(buckets_begin[i], f);
         checkpoints[0] = f;
     }
 
@@ -293,9 +326,12 @@ class FastAlgorithmCallback : public WesolowskiCallback {
         return position;
     }
 
-    form *GetForm(uint64_t exponent, int bucket) {
-        uint64_t pos = GetPosition(exponent, bucket);
-        return &(forms[pos]);
+    form GetForm(uint64_t exponent, int bucket) {
+        return intermediates->Get(GetPosition(exponent, bucket));
+    }
+
+    void SetIntermediate(uint64_t exponent, int bucket, const form& f) {
+        intermediates->Set(GetPosition(exponent, bucket), f);
     }
 
     // We need to store:
@@ -314,8 +350,8 @@ class FastAlgorithmCallback : public WesolowskiCallback {
                 uint64_t power_2 = 1LL << (16 + 2LL * i);
                 int kl = (i == 0) ? 10 : (12 * (power_2 >> 18));
                 if ((iteration % power_2) % kl == 0) {
-                    form* mulf = GetForm(iteration, i);
-                    SetForm(type, data, mulf);
+                    SetForm(type, data, &scratch);
+                    SetIntermediate(iteration, i, scratch);
                 }
             }
         }
@@ -323,13 +359,58 @@ class FastAlgorithmCallback : public WesolowskiCallback {
         if (iteration % (1 << 16) == 0) {
             form* mulf = (&checkpoints[(iteration / (1 << 16))]);
             SetForm(type, data, mulf);
+            if (checkpoint_store != nullptr) {
+                checkpoint_store->AppendCheckpoint(iteration / (1 << 16), *mulf);
+            }
         }
     }
 
+    // Restores the checkpoints of an interrupted session. The VDF loop then
+    // continues from checkpoints[resume_iteration / 2^16].
+    void Resume(const CheckpointState& state, uint64_t resume_iteration) {
+        for (size_t i = 0; i < state.checkpoints.size() && i < (1 << 18); i++)
+            checkpoints[i] = state.checkpoints[i];
+        y_ret = checkpoints[resume_iteration / (1 << 16)];
+        iterations = resume_iteration;
+        // The VDF loop only reports the iterations after its start.
+        for (int i = 0; i < segments; i++) {
+            uint64_t power_2 = 1LL << (16 + 2 * i);
+            int kl = (i == 0) ? 10 : (12 * (power_2 >> 18));
+            if ((resume_iteration % power_2) % kl == 0) {
+                SetIntermediate(resume_iteration, i, y_ret);
+            }
+        }
+    }
+
+    // Wakes this session's ProverManager event loop: intermediates of a
+    // segment are stored, a prover finished or the manager is stopping.
+    void NotifyEvent() {
+        {
+            std::lock_guard<std::mutex> lk(event_mutex);
+            event_pending = true;
+        }
+        event_cv.notify_all();
+    }
+
+    void WaitForEvent() {
+        std::unique_lock<std::mutex> lk(event_mutex);
+        event_cv.wait(lk, [this] { return event_pending; });
+        event_pending = false;
+    }
+
     std::vector<int> buckets_begin;
-    std::unique_ptr<form[]> checkpoints;
+    // Intermediates of all buckets, indexed by GetPosition().
+    std::unique_ptr<CompactFormStore> intermediates;
+    LargeArray<form> checkpoints;
+    // Only touched by the VDF thread.
+    form scratch;
     form y_ret;
     int segments;
+    // Optional on-disk log of the checkpoints, owned by the caller.
+    CheckpointStore* checkpoint_store = nullptr;
+    std::mutex event_mutex;
+    std::condition_variable event_cv;
+    bool event_pending = false;
     // The intermediate values size of a 2^16 segment.
     const int bucket_size1 = 6554;
     // The intermediate values size of a >= 2^18 segment.
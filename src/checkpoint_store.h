@@ -0,0 +1,280 @@
+#ifndef CHECKPOINT_STORE_H
+#define CHECKPOINT_STORE_H
+
+#include "proof_common.h"
+#include "picosha2.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// On-disk log of an n-weso session, so a restarted vdf_client can resume
+// instead of squaring from the start. The file is a fixed header followed by
+// fixed-size records, each holding one compressed form:
+//   header: magic (8) | version (4) | d_bits (4) | session id (32)
+//   record: kind (1) | bucket (1) | reserved (6) | index (8, LE) | form (BQFC_FORM_SIZE)
+// Checkpoint records hold the form after index * 2^16 iterations and are
+// appended in order by the VDF loop. Segment records hold the proof of the
+// segment of bucket `bucket` starting at iteration `index`.
+// Records are only appended, so a crash can at worst leave a torn last
+// record, which is ignored on load.
+
+const char kCheckpointStoreMagic[8] = {'C', 'V', 'D', 'F', 'C', 'K', 'P', 'T'};
+const uint32_t kCheckpointStoreVersion = 1;
+const size_t kCheckpointStoreHeaderSize = 8 + 4 + 4 + 32;
+const size_t kCheckpointStoreRecordSize = 16 + BQFC_FORM_SIZE;
+
+// Environment variable naming the directory vdf_client keeps session logs in.
+const char kCheckpointDirEnv[] = "CHIAVDF_CHECKPOINT_DIR";
+
+enum CheckpointRecordKind : uint8_t {
+    kCheckpointRecord = 1,
+    kSegmentProofRecord = 2,
+};
+
+struct CheckpointState {
+    // checkpoints[n] is the form after n * 2^16 iterations.
+    std::vector<form> checkpoints;
+    // segment_proofs[bucket] maps the segment start to its proof.
+    std::vector<std::vector<std::pair<uint64_t, form>>> segment_proofs;
+};
+
+// Identifies a session by its discriminant and initial form.
+inline std::vector<uint8_t> GetCheckpointSessionId(const integer& D, form& x) {
+    std::vector<uint8_t> data = D.to_bytes();
+    std::vector<uint8_t> x_bytes = SerializeForm(x, D.num_bits());
+    data.insert(data.end(), x_bytes.begin(), x_bytes.end());
+    std::vector<uint8_t> id(picosha2::k_digest_size);
+    picosha2::hash256(data.begin(), data.end(), id.begin(), id.end());
+    return id;
+}
+
+inline std::string GetCheckpointStorePath(const std::string& dir, const integer& D, form& x) {
+    static const char hex[] = "0123456789abcdef";
+    std::vector<uint8_t> id = GetCheckpointSessionId(D, x);
+    std::string name;
+    for (size_t i = 0; i < 16; i++) {
+        name += hex[id[i] >> 4];
+        name += hex[id[i] & 15];
+    }
+    return dir + "/" + name + ".ckpt";
+}
+
+class CheckpointStore {
+  public:
+    // Opens the log at path, creating it if needed. A file written for a
+    // different session or with an unknown version is replaced. Whatever the
+    // file already holds is available through GetState().
+    CheckpointStore(const std::string& path, const integer& D, form& x) : D(D) {
+        d_bits = D.num_bits();
+        session_id = GetCheckpointSessionId(D, x);
+        state.checkpoints.push_back(x);
+
+        size_t valid_size = Load(path);
+        if (valid_size == 0) {
+            file = std::fopen(path.c_str(), "w+b");
+            if (file == nullptr) {
+                throw std::runtime_error("CheckpointStore: cannot create " + path);
+            }
+            // Checkpoint 0 is the initial form itself.
+            if (!WriteHeader() || !WriteRecord(kCheckpointRecord, 0, 0, x)) {
+                std::fclose(file);
+                throw std::runtime_error("CheckpointStore: cannot write " + path);
+            }
+        } else {
+            file = std::fopen(path.c_str(), "r+b");
+            if (file == nullptr) {
+                throw std::runtime_error("CheckpointStore: cannot open " + path);
+            }
+            // Drop a torn trailing record so new records stay aligned.
+            if (std::fseek(file, static_cast<long>(valid_size), SEEK_SET) != 0) {
+                std::fclose(file);
+                throw std::runtime_error("CheckpointStore: cannot seek " + path);
+            }
+        }
+    }
+
+    ~CheckpointStore() {
+        if (file != nullptr)
+            std::fclose(file);
+    }
+
+    CheckpointStore(const CheckpointStore&) = delete;
+    CheckpointStore& operator=(const CheckpointStore&) = delete;
+
+    // Contents of the log when it was opened.
+    const CheckpointState& GetState() const {
+        return state;
+    }
+
+    // Appends the form after index * 2^16 iterations. Checkpoints that are
+    // already stored or would leave a gap are ignored.
+    // Appends run on the VDF and prover threads and never throw: the log is
+    // optional, so after a failed write (e.g. a full disk) it is disabled and
+    // the session continues without it.
+    void AppendCheckpoint(uint64_t index, form& f) {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (failed || index != num_checkpoints)
+            return;
+        if (!WriteRecord(kCheckpointRecord, 0, index, f)) {
+            Disable();
+            return;
+        }
+        num_checkpoints++;
+    }
+
+    void AppendSegmentProof(int bucket, uint64_t start, form& proof) {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (failed)
+            return;
+        if (!WriteRecord(kSegmentProofRecord, static_cast<uint8_t>(bucket), start, proof))
+            Disable();
+    }
+
+    // True once a write failed and appends are dropped.
+    bool IsDisabled() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return failed;
+    }
+
+    uint64_t NumCheckpoints() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return num_checkpoints;
+    }
+
+  private:
+    integer D;
+    int d_bits;
+    std::vector<uint8_t> session_id;
+    CheckpointState state;
+    std::mutex mutex;
+    std::FILE* file = nullptr;
+    uint64_t num_checkpoints = 1;
+    bool failed = false;
+
+    void Disable() {
+        failed = true;
+        std::fclose(file);
+        file = nullptr;
+        std::cerr << "CheckpointStore: write failed, no longer logging this session.\n" << std::flush;
+    }
+
+    bool WriteHeader() {
+        uint8_t header[kCheckpointStoreHeaderSize] = {};
+        std::memcpy(header, kCheckpointStoreMagic, 8);
+        for (int i = 0; i < 4; i++) {
+            header[8 + i] = static_cast<uint8_t>(kCheckpointStoreVersion >> (8 * i));
+            header[12 + i] = static_cast<uint8_t>(static_cast<uint32_t>(d_bits) >> (8 * i));
+        }
+        std::memcpy(header + 16, session_id.data(), session_id.size());
+        return std::fwrite(header, 1, sizeof(header), file) == sizeof(header) && std::fflush(file) == 0;
+    }
+
+    bool WriteRecord(uint8_t kind, uint8_t bucket, uint64_t index, form& f) {
+        uint8_t record[kCheckpointStoreRecordSize] = {};
+        record[0] = kind;
+        record[1] = bucket;
+        for (int i = 0; i < 8; i++)
+            record[8 + i] = static_cast<uint8_t>(index >> (8 * i));
+        std::vector<uint8_t> bytes = SerializeForm(f, d_bits);
+        std::memcpy(record + 16, bytes.data(), BQFC_FORM_SIZE);
+        // Flushed per record: the log has to survive a crash of the process,
+        // not of the machine, so no fsync.
+        return std::fwrite(record, 1, sizeof(record), file) == sizeof(record) && std::fflush(file) == 0;
+    }
+
+    // Parses an existing log. Returns the size of its valid prefix, or 0 if
+    // there is no usable file.
+    size_t Load(const std::string& path) {
+        std::vector<uint8_t> buffer;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+#if !defined(_WIN32)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return 0;
+        struct stat st;
+        void* mapped = MAP_FAILED;
+        if (::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= kCheckpointStoreHeaderSize) {
+            size = static_cast<size_t>(st.st_size);
+            mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return 0;
+        data = static_cast<const uint8_t*>(mapped);
+#else
+        std::FILE* in = std::fopen(path.c_str(), "rb");
+        if (in == nullptr)
+            return 0;
+        uint8_t chunk[1 << 16];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), in)) > 0)
+            buffer.insert(buffer.end(), chunk, chunk + n);
+        std::fclose(in);
+        data = buffer.data();
+        size = buffer.size();
+#endif
+        size_t valid_size = Parse(data, size);
+#if !defined(_WIN32)
+        ::munmap(mapped, size);
+#endif
+        return valid_size;
+    }
+
+    size_t Parse(const uint8_t* data, size_t size) {
+        if (size < kCheckpointStoreHeaderSize || std::memcmp(data, kCheckpointStoreMagic, 8) != 0)
+            return 0;
+        uint32_t version = 0, bits = 0;
+        for (int i = 0; i < 4; i++) {
+            version |= static_cast<uint32_t>(data[8 + i]) << (8 * i);
+            bits |= static_cast<uint32_t>(data[12 + i]) << (8 * i);
+        }
+        if (version != kCheckpointStoreVersion || bits != static_cast<uint32_t>(d_bits) ||
+            std::memcmp(data + 16, session_id.data(), session_id.size()) != 0) {
+            return 0;
+        }
+
+        size_t offset = kCheckpointStoreHeaderSize;
+        for (; offset + kCheckpointStoreRecordSize <= size; offset += kCheckpointStoreRecordSize) {
+            const uint8_t* record = data + offset;
+            uint64_t index = 0;
+            for (int i = 0; i < 8; i++)
+                index |= static_cast<uint64_t>(record[8 + i]) << (8 * i);
+            form f;
+            try {
+                f = DeserializeForm(D, record + 16, BQFC_FORM_SIZE);
+            } catch (std::exception&) {
+                break;
+            }
+            if (record[0] == kCheckpointRecord) {
+                if (index == 0)
+                    continue;
+                if (index != state.checkpoints.size())
+                    break;
+                state.checkpoints.push_back(f);
+            } else if (record[0] == kSegmentProofRecord) {
+                if (state.segment_proofs.size() <= record[1])
+                    state.segment_proofs.resize(record[1] + 1);
+                state.segment_proofs[record[1]].emplace_back(index, f);
+            } else {
+                break;
+            }
+        }
+        num_checkpoints = state.checkpoints.size();
+        return offset;
+    }
+};
+
+#endif // CHECKPOINT_STORE_H
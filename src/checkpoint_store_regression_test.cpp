@@ -0,0 +1,235 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+#include "checkpoint_store.h"
+#include "vdf.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+class CheckpointStoreRegressionTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+        d = CreateDiscriminant(challenge_hash, 1024);
+        x = form::generator(d);
+        // Stand-ins for the forms after n * 2^16 iterations.
+        integer L = root(-d, 4);
+        PulmarkReducer reducer;
+        form y = x;
+        for (int i = 0; i < 5; i++) {
+            checkpoints.push_back(y);
+            for (int j = 0; j < 7; j++) {
+                nudupl_form(y, y, d, L);
+                reducer.reduce(y);
+            }
+        }
+        path = GetCheckpointStorePath(::testing::TempDir(), d, x);
+        std::remove(path.c_str());
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    integer d;
+    form x;
+    std::vector<form> checkpoints;
+    std::string path;
+};
+
+TEST_F(CheckpointStoreRegressionTest, RoundTripsCheckpointsAndSegmentProofs) {
+    {
+        CheckpointStore store(path, d, x);
+        ASSERT_EQ(store.GetState().checkpoints.size(), 1u);
+        EXPECT_EQ(store.GetState().checkpoints[0], x);
+        for (uint64_t i = 1; i < checkpoints.size(); i++)
+            store.AppendCheckpoint(i, checkpoints[i]);
+        // Duplicates and gaps are ignored.
+        store.AppendCheckpoint(2, checkpoints[0]);
+        store.AppendCheckpoint(9, checkpoints[0]);
+        EXPECT_EQ(store.NumCheckpoints(), checkpoints.size());
+        store.AppendSegmentProof(0, 0, checkpoints[3]);
+        store.AppendSegmentProof(1, 1 << 18, checkpoints[4]);
+    }
+
+    CheckpointStore reopened(path, d, x);
+    const CheckpointState& state = reopened.GetState();
+    ASSERT_EQ(state.checkpoints.size(), checkpoints.size());
+    for (size_t i = 0; i < checkpoints.size(); i++)
+        EXPECT_EQ(state.checkpoints[i], checkpoints[i]) << "i=" << i;
+    ASSERT_EQ(state.segment_proofs.size(), 2u);
+    ASSERT_EQ(state.segment_proofs[0].size(), 1u);
+    EXPECT_EQ(state.segment_proofs[0][0].first, 0u);
+    EXPECT_EQ(state.segment_proofs[0][0].second, checkpoints[3]);
+    ASSERT_EQ(state.segment_proofs[1].size(), 1u);
+    EXPECT_EQ(state.segment_proofs[1][0].first, uint64_t(1) << 18);
+    EXPECT_EQ(state.segment_proofs[1][0].second, checkpoints[4]);
+}
+
+TEST_F(CheckpointStoreRegressionTest, IgnoresTornTrailingRecord) {
+    {
+        CheckpointStore store(path, d, x);
+        for (uint64_t i = 1; i < 4; i++)
+            store.AppendCheckpoint(i, checkpoints[i]);
+    }
+    // Simulate a crash in the middle of writing the next record.
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        std::vector<char> partial(kCheckpointStoreRecordSize / 2, 1);
+        out.write(partial.data(), partial.size());
+    }
+    {
+        CheckpointStore store(path, d, x);
+        EXPECT_EQ(store.GetState().checkpoints.size(), 4u);
+        store.AppendCheckpoint(4, checkpoints[4]);
+    }
+    CheckpointStore reopened(path, d, x);
+    ASSERT_EQ(reopened.GetState().checkpoints.size(), 5u);
+    EXPECT_EQ(reopened.GetState().checkpoints[4], checkpoints[4]);
+}
+
+TEST_F(CheckpointStoreRegressionTest, RejectsLogOfAnotherSession) {
+    {
+        CheckpointStore store(path, d, x);
+        store.AppendCheckpoint(1, checkpoints[1]);
+    }
+    // Same file, different initial form: the old log must not be reused.
+    CheckpointStore other(path, d, checkpoints[2]);
+    ASSERT_EQ(other.GetState().checkpoints.size(), 1u);
+    EXPECT_EQ(other.GetState().checkpoints[0], checkpoints[2]);
+}
+
+#if !defined(_WIN32)
+TEST_F(CheckpointStoreRegressionTest, DisablesItselfWhenAWriteFails) {
+    CheckpointStore store(path, d, x);
+    store.AppendCheckpoint(1, checkpoints[1]);
+
+    // Cap the file size to fail the next write, as a full disk would.
+    struct rlimit old_limit;
+    ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &old_limit), 0);
+    struct rlimit limit = old_limit;
+    limit.rlim_cur = kCheckpointStoreHeaderSize + 2 * kCheckpointStoreRecordSize;
+    void (*old_handler)(int) = std::signal(SIGXFSZ, SIG_IGN);
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+    EXPECT_NO_THROW(store.AppendCheckpoint(2, checkpoints[2]));
+    EXPECT_NO_THROW(store.AppendSegmentProof(0, 0, checkpoints[3]));
+    setrlimit(RLIMIT_FSIZE, &old_limit);
+    std::signal(SIGXFSZ, old_handler);
+
+    EXPECT_TRUE(store.IsDisabled());
+    EXPECT_EQ(store.NumCheckpoints(), 2u);
+    // Appends stay dropped once writes would succeed again.
+    store.AppendCheckpoint(2, checkpoints[2]);
+    EXPECT_EQ(store.NumCheckpoints(), 2u);
+}
+#endif
+
+TEST_F(CheckpointStoreRegressionTest, ResumeRejectsSegmentProofsThatDoNotVerify) {
+    // Two real 2^16 segments from x, with their proofs x^(2^T / B).
+    CheckpointState state;
+    state.checkpoints.push_back(x);
+    state.segment_proofs.resize(1);
+    integer L = root(-d, 4);
+    PulmarkReducer reducer;
+    form y = x;
+    for (uint64_t i = 0; i < 2; i++) {
+        form start = y;
+        for (int j = 0; j < (1 << 16); j++) {
+            nudupl_form(y, y, d, L);
+            reducer.reduce(y);
+        }
+        state.checkpoints.push_back(y);
+        integer B = GetB(d, start, y);
+        integer q = (integer(1) << (1 << 16)) / B;
+        state.segment_proofs[0].emplace_back(i << 16, FastPowFormNucomp(start, d, q, L, reducer));
+    }
+    uint64_t resume_iteration = ProverManager::GetResumeIteration(state);
+    ASSERT_EQ(resume_iteration, uint64_t(2) << 16);
+    FastAlgorithmCallback weso(1, d, x, false);
+    {
+        ProverManager pm(d, &weso, nullptr, 1, 1);
+        EXPECT_EQ(pm.Resume(state, resume_iteration), resume_iteration);
+    }
+
+    // A damaged record that still deserializes: its segment is proven again,
+    // so squaring resumes where it starts.
+    state.segment_proofs[0][1].second = state.checkpoints[1];
+    ProverManager pm(d, &weso, nullptr, 1, 1);
+    EXPECT_EQ(pm.Resume(state, resume_iteration), uint64_t(1) << 16);
+}
+
+TEST_F(CheckpointStoreRegressionTest, ResumeInsideALargerSegmentProvesFarPastIt) {
+    // A smaller discriminant, as this squares about 2^22 times.
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 512);
+    form x = form::generator(d);
+    integer L = root(-d, 4);
+    PulmarkReducer reducer;
+
+    // A session interrupted after 6 * 2^16 iterations: its 2^16 segments and
+    // the first 2^18 one are proven, the second 2^18 one was cut.
+    const uint64_t resume = uint64_t(6) << 16;
+    CheckpointState state;
+    state.checkpoints.push_back(x);
+    state.segment_proofs.resize(2);
+    form y = x;
+    for (uint64_t i = 0; i < (resume >> 16); i++) {
+        for (int j = 0; j < (1 << 16); j++) {
+            nudupl_form(y, y, d, L);
+            reducer.reduce(y);
+        }
+        state.checkpoints.push_back(y);
+    }
+    auto prove = [&](uint64_t start, int length) {
+        form& from = state.checkpoints[start >> 16];
+        integer B = GetB(d, from, state.checkpoints[(start + length) >> 16]);
+        return FastPowFormNucomp(from, d, (integer(1) << length) / B, L, reducer);
+    };
+    for (uint64_t i = 0; i < (resume >> 16); i++)
+        state.segment_proofs[0].emplace_back(i << 16, prove(i << 16, 1 << 16));
+    state.segment_proofs[1].emplace_back(0, prove(0, 1 << 18));
+
+    FastAlgorithmCallback weso(2, d, x, false);
+    ProverManager pm(d, &weso, nullptr, 2, 2);
+    ASSERT_EQ(pm.Resume(state, ProverManager::GetResumeIteration(state)), resume);
+    pm.start();
+
+    // Beyond what 63 segments of 2^16 cover from the resume point, so the
+    // proof needs the 2^18 segment cut by the interruption.
+    const uint64_t iteration = resume + (uint64_t(65) << 16);
+    std::future<Proof> pending = std::async(std::launch::async, [&] { return pm.Prove(iteration); });
+    // Stands in for the VDF loop, which stores the intermediates from the
+    // resume point on.
+    for (uint64_t i = resume; i < iteration; i++) {
+        nudupl_form(y, y, d, L);
+        reducer.reduce(y);
+        weso.OnIteration(NL_FORM, &y, i);
+        if ((i + 1) % (1 << 16) == 0) {
+            weso.PublishIterations(i + 1);
+            weso.NotifyEvent();
+        }
+    }
+    bool proven = pending.wait_for(std::chrono::minutes(10)) == std::future_status::ready;
+    pm.stop();
+    Proof proof = pending.get();
+    ASSERT_TRUE(proven);
+
+    EXPECT_LT(proof.witness_type, 63);
+    std::vector<uint8_t> blob(proof.y);
+    blob.insert(blob.end(), proof.proof.begin(), proof.proof.end());
+    EXPECT_TRUE(CheckProofOfTimeNWesolowski(d, DEFAULT_ELEMENT, blob.data(), blob.size(), iteration, d.num_bits(),
+                                            proof.witness_type));
+}
@@ -0,0 +1,97 @@
+#ifndef COMPACT_FORM_STORE_H
+#define COMPACT_FORM_STORE_H
+
+#include "alloc.hpp"
+#include "vdf_new.h"
+
+#include <cstring>
+#include <stdexcept>
+
+// Fixed-capacity array of reduced forms kept as (a, b) only, in one
+// structure-of-arrays allocation: all a limbs, then all b limbs, then the
+// signed limb counts. c is recomputed from D on read. Every slot reserves
+// enough limbs for a reduced form, |b| <= a <= sqrt(|D| / 3), plus one.
+// Slots are written and read without locking; as with a plain form array,
+// callers must not read a slot while it is being written.
+class CompactFormStore {
+  public:
+    CompactFormStore(const integer& D, size_t capacity) : D(D), capacity(capacity) {
+        limbs_per_value = (D.num_bits() / 2 + 1 + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS + 1;
+        size_t limb_count = 2 * capacity * limbs_per_value;
+        // Zeroed and lazily mapped (in 2 MiB steps with huge pages), so only
+        // the slots that are actually written count towards RSS.
+        limb_buffer.Allocate(limb_count * sizeof(mp_limb_t), /*zeroed=*/true);
+        size_buffer.Allocate(2 * capacity * sizeof(int32_t), /*zeroed=*/true);
+        limbs = static_cast<mp_limb_t*>(limb_buffer.get());
+        sizes = static_cast<int32_t*>(size_buffer.get());
+    }
+
+    CompactFormStore(const CompactFormStore&) = delete;
+    CompactFormStore& operator=(const CompactFormStore&) = delete;
+
+    size_t Capacity() const {
+        return capacity;
+    }
+
+    void Set(size_t pos, const form& f) {
+        if (pos >= capacity) {
+            throw std::runtime_error("CompactFormStore::Set out of bounds");
+        }
+        size_t a_size = mpz_size(f.a.impl);
+        size_t b_size = mpz_size(f.b.impl);
+        if (a_size > limbs_per_value || b_size > limbs_per_value) {
+            // Only reachable with an unreduced form; store its reduction.
+            form reduced = f;
+            reduced.reduce();
+            if (mpz_size(reduced.a.impl) > limbs_per_value || mpz_size(reduced.b.impl) > limbs_per_value) {
+                throw std::runtime_error("CompactFormStore::Set form does not fit");
+            }
+            Set(pos, reduced);
+            return;
+        }
+        std::memcpy(ALimbs(pos), mpz_limbs_read(f.a.impl), a_size * sizeof(mp_limb_t));
+        std::memcpy(BLimbs(pos), mpz_limbs_read(f.b.impl), b_size * sizeof(mp_limb_t));
+        sizes[pos] = f.a.impl->_mp_size;
+        sizes[capacity + pos] = f.b.impl->_mp_size;
+    }
+
+    // Returns the form in slot pos; an unwritten slot reads as all zeros.
+    form Get(size_t pos) const {
+        if (pos >= capacity) {
+            throw std::runtime_error("CompactFormStore::Get out of bounds");
+        }
+        form f;
+        mpz_t view;
+        mpz_set(f.a.impl, mpz_roinit_n(view, ALimbs(pos), sizes[pos]));
+        mpz_set(f.b.impl, mpz_roinit_n(view, BLimbs(pos), sizes[capacity + pos]));
+        if (mpz_sgn(f.a.impl) == 0) {
+            mpz_set_ui(f.c.impl, 0);
+            return f;
+        }
+        // c = (b^2 - D) / (4a), an exact division.
+        mpz_mul(f.c.impl, f.b.impl, f.b.impl);
+        mpz_sub(f.c.impl, f.c.impl, D.impl);
+        mpz_divexact(f.c.impl, f.c.impl, f.a.impl);
+        mpz_tdiv_q_2exp(f.c.impl, f.c.impl, 2);
+        return f;
+    }
+
+  private:
+    integer D;
+    size_t capacity;
+    size_t limbs_per_value;
+    LargeBuffer limb_buffer;
+    LargeBuffer size_buffer;
+    mp_limb_t* limbs;
+    int32_t* sizes;
+
+    mp_limb_t* ALimbs(size_t pos) const {
+        return limbs + pos * limbs_per_value;
+    }
+
+    mp_limb_t* BLimbs(size_t pos) const {
+        return limbs + (capacity + pos) * limbs_per_value;
+    }
+};
+
+#endif // COMPACT_FORM_STORE_H
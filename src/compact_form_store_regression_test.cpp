@@ -0,0 +1,69 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+#include "compact_form_store.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+class CompactFormStoreRegressionTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+        d = CreateDiscriminant(challenge_hash, 1024);
+        integer L = root(-d, 4);
+        PulmarkReducer reducer;
+        form y = form::generator(d);
+        for (int i = 0; i < 64; i++) {
+            forms.push_back(y);
+            nudupl_form(y, y, d, L);
+            reducer.reduce(y);
+        }
+    }
+
+    integer d;
+    std::vector<form> forms;
+};
+
+TEST_F(CompactFormStoreRegressionTest, RoundTripsReducedForms) {
+    CompactFormStore store(d, 2 * forms.size());
+    EXPECT_EQ(store.Capacity(), 2 * forms.size());
+    for (size_t i = 0; i < forms.size(); i++)
+        store.Set(2 * i + 1, forms[i]);
+    for (size_t i = 0; i < forms.size(); i++) {
+        form g = store.Get(2 * i + 1);
+        EXPECT_EQ(g, forms[i]) << "i=" << i;
+        EXPECT_EQ(g.c, forms[i].c) << "i=" << i;
+        EXPECT_EQ(g.check_valid(d), true);
+    }
+    // Overwriting a slot replaces it entirely.
+    store.Set(1, forms[5]);
+    EXPECT_EQ(store.Get(1), forms[5]);
+}
+
+TEST_F(CompactFormStoreRegressionTest, UnwrittenSlotsReadAsZero) {
+    CompactFormStore store(d, 4);
+    form g = store.Get(2);
+    EXPECT_EQ(g.a, integer(0));
+    EXPECT_EQ(g.b, integer(0));
+    EXPECT_EQ(g.c, integer(0));
+}
+
+TEST_F(CompactFormStoreRegressionTest, ReducesOversizedAndRejectsOutOfBounds) {
+    CompactFormStore store(d, 4);
+
+    // An equivalent form with b shifted by 2 * a * 2^2048 is far too wide
+    // for a slot, so the store keeps its reduction instead.
+    const form& reduced = forms[10];
+    integer shift = reduced.a * integer(2);
+    shift <<= 2048;
+    form wide = form::from_abd(reduced.a, reduced.b + shift, d);
+    ASSERT_TRUE(wide.check_valid(d));
+    store.Set(0, wide);
+    EXPECT_EQ(store.Get(0), reduced);
+
+    EXPECT_THROW(store.Set(4, forms[0]), std::runtime_error);
+    EXPECT_THROW(store.Get(4), std::runtime_error);
+}
@@ -3,7 +3,10 @@
 
 #include "proof_common.h"
 
-integer CreateDiscriminant(std::vector<uint8_t>& seed, int length = 1024) {
+// num_threads other than 1 searches for the prime on that many threads, at
+// most one per hardware thread (0 uses all of them); the discriminant is the
+// same either way. A negative num_threads throws std::invalid_argument.
+integer CreateDiscriminant(std::vector<uint8_t>& seed, int length = 1024, int num_threads = 1) {
     // INPUT VALIDATION - Fix for issue #282
     
     // Check 1: Validate discriminant_size_bits is positive
@@ -35,7 +38,7 @@ integer CreateDiscriminant(std::vector<uint8_t>& seed, int length = 1024) {
         throw std::invalid_argument("seed cannot be empty");
     }
     
-    return HashPrime(seed, length, {0, 1, 2, length - 1}) * integer(-1);
+    return HashPrimeParallel(seed, length, {0, 1, 2, length - 1}, num_threads) * integer(-1);
 }
 
 #endif // CREATE_DISCRIMINANT_H
@@ -0,0 +1,59 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+integer get_fast_pow_discriminant() {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    return CreateDiscriminant(challenge_hash, 1024);
+}
+
+}  // namespace
+
+TEST(FastPowRegressionTest, WNafDigitsReconstructExponent) {
+    std::vector<integer> exponents({integer(1), integer(2), integer(7), integer(255),
+                                    integer("0x9a3c5e7f00112233445566778899aabbccddeeff0123456789abcdef0fedcba98")});
+    for (int w = 2; w <= 7; w++) {
+        for (const integer& e : exponents) {
+            std::vector<int8_t> digits = GetWNafDigits(e, w);
+            integer value(0);
+            for (size_t i = digits.size(); i-- > 0;) {
+                value = value * integer(2) + integer(static_cast<int>(digits[i]));
+                if (digits[i]) {
+                    EXPECT_EQ(digits[i] & 1, 1);
+                    EXPECT_LT(std::abs(digits[i]), 1 << (w - 1));
+                }
+            }
+            EXPECT_EQ(value, e) << "w=" << w;
+            EXPECT_GT(digits.back(), 0);
+        }
+    }
+}
+
+TEST(FastPowRegressionTest, WindowedMatchesBinaryExponentiation) {
+    integer d = get_fast_pow_discriminant();
+    integer L = root(-d, 4);
+    PulmarkReducer reducer;
+    form g = form::generator(d);
+    form x = FastPowFormNucompWindowed(g, d, integer(987654321), L, reducer, 1);
+
+    std::vector<integer> exponents({integer(0), integer(1), integer(2), integer(3), integer(1 << 16),
+                                    HashPrime({9, 9, 9}, B_bits, {B_bits - 1})});
+    for (const integer& e : exponents) {
+        form expected = FastPowFormNucompWindowed(x, d, e, L, reducer, 1);
+        expected.reduce();
+        for (int w = 2; w <= 7; w++) {
+            form actual = FastPowFormNucompWindowed(x, d, e, L, reducer, w);
+            actual.reduce();
+            EXPECT_EQ(actual, expected) << "w=" << w << " e=" << e.to_string();
+        }
+        form adaptive = FastPowFormNucomp(x, d, e, L, reducer);
+        adaptive.reduce();
+        EXPECT_EQ(adaptive, expected);
+    }
+}
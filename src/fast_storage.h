@@ -10,121 +10,248 @@
 #define FAST_STORAGE_H
 
 #include "vdf_new.h"
+#include "thread_affinity.h"
 
-extern bool new_event;
-extern std::mutex new_event_mutex;
-extern std::condition_variable new_event_cv;
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 
+// Bounds for the number of threads recomputing intermediates.
+const int kMinIntermediatesThreads = 2;
+const int kInitialIntermediatesThreads = 6;
+// Run this much more recompute capacity than the VDF loop strictly needs.
+const double kIntermediatesHeadroom = 1.25;
+
+// Recomputes, on worker threads, the intermediates the VDF loop skipped. The
+// number of active workers follows the measured rates: a worker needs
+// block_seconds per 2^15 iterations while the VDF loop produces a block
+// every checkpoint_seconds, so about block_seconds / checkpoint_seconds
+// workers keep up, plus one while a backlog builds. This keeps provers fed
+// without taking cores from the VDF loop. Pending blocks are recomputed
+// lowest iteration first, since every proof request needs all the
+// segments below it, so the oldest request is always unblocked first.
 class FastStorage {
   public:
     FastStorage(FastAlgorithmCallback* weso) {
         stopped = false;
         this->weso = weso;
-        intermediates_stored = new bool[(1 << 19)];
-        for (int i = 0; i < (1 << 19); i++)
+        intermediates_stored.reset(new std::atomic<uint64_t>[kStoredWords]);
+        for (int i = 0; i < kStoredWords; i++)
             intermediates_stored[i] = 0;
 
-        for (int i = 0; i < intermediates_threads; i++) {
-            storage_threads.push_back(std::thread([=] {CalculateIntermediatesThread(); }));
-        }
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        max_threads = std::max(kMinIntermediatesThreads, cores / 2);
+        target_threads = std::min(kInitialIntermediatesThreads, max_threads);
+        std::lock_guard<std::mutex> lk(intermediates_mutex);
+        SpawnThreadsLocked();
     }
 
     ~FastStorage() {
+        // No thread is spawned once stopped is set, so the moved-out list is
+        // complete.
+        std::vector<std::thread> threads;
         {
             std::lock_guard<std::mutex> lk(intermediates_mutex);
             stopped = true;
+            threads.swap(storage_threads);
         }
         intermediates_cv.notify_all();
-        for (int i = 0; i < storage_threads.size(); i++) {
-            storage_threads[i].join();
+        for (int i = 0; i < threads.size(); i++) {
+            threads[i].join();
         }
-        delete[] intermediates_stored;
         std::cout << "Fast storage fully stopped.\n" << std::flush;
     }
 
+    // Workers for a recompute time of block_seconds per 2^15 iterations, a
+    // VDF loop producing a block every checkpoint_seconds and backlog
+    // blocks waiting; 0 for an unmeasured rate keeps `current`.
+    static int ComputeTargetThreads(double block_seconds, double checkpoint_seconds, size_t backlog,
+                                    int current, int min_threads, int max_threads) {
+        int target = current;
+        if (block_seconds > 0 && checkpoint_seconds > 0) {
+            target = static_cast<int>(std::ceil(kIntermediatesHeadroom * block_seconds / checkpoint_seconds));
+        }
+        if (backlog > static_cast<size_t>(target))
+            target++;
+        return std::max(min_threads, std::min(target, max_threads));
+    }
+
+    int GetTargetThreads() {
+        std::lock_guard<std::mutex> lk(intermediates_mutex);
+        return target_threads;
+    }
+
     void AddIntermediates(uint64_t iter) {
-        int bucket = iter / (1 << 16);
-        int subbucket = 0;
+        uint64_t bucket = iter / (1 << 16);
+        uint64_t subbucket = 0;
         if (iter % (1 << 16))
             subbucket = 1;
-        bool has_event = false;
-        {
-            intermediates_stored[2 * bucket + subbucket] = true;
-            if (intermediates_stored[2 * bucket] == true &&
-                intermediates_stored[2 * bucket + 1] == true)
-                    has_event = true;
-        }
+        // Both halves of a 2^16 segment share a word; whichever half lands
+        // second announces the segment.
+        uint64_t bit = 2 * bucket + subbucket;
+        uint64_t pair = uint64_t(3) << (2 * bucket % 64);
+        uint64_t old = intermediates_stored[bit / 64].fetch_or(uint64_t(1) << (bit % 64), std::memory_order_acq_rel);
+        bool has_event = (old & pair) != pair && ((old | (uint64_t(1) << (bit % 64))) & pair) == pair;
         if (has_event) {
-            {
-                std::lock_guard<std::mutex> lk(new_event_mutex);
-                new_event = true;
-            }
-            new_event_cv.notify_all();
+            weso->NotifyEvent();
         }
     }
 
-    void CalculateIntermediatesInner(form y, uint64_t iter_begin) {
-        PulmarkReducer reducer;
+    // Stores the intermediates of the 2^15 iterations from iter_begin and
+    // returns the form after them.
+    form CalculateIntermediatesInner(form y, uint64_t iter_begin) {
+        PulmarkReducer& reducer = GetThreadPulmarkReducer();
         integer& D = weso->D;
         integer& L = weso->L;
         int segments = weso->segments;
+        // Before a resumed session's start, only the buckets whose segments
+        // there are unproven need them.
+        std::vector<bool> needed(segments, true);
+        for (int i = 0; i < segments && i < (int)intermediates_begin.size(); i++)
+            needed[i] = iter_begin >= intermediates_begin[i];
         for (uint64_t iteration = iter_begin; iteration < iter_begin + (1 << 15); iteration++) {
             for (int i = 0; i < segments; i++) {
                 uint64_t power_2 = 1LL << (16 + 2 * i);
                 int kl = (i == 0) ? 10 : (12 * (power_2 >> 18));
-                if ((iteration % power_2) % kl == 0) {
-                    if (stopped) return;
-                    form* mulf = weso->GetForm(iteration, i);
-                    weso->SetForm(NL_FORM, &y, mulf, /*reduced=*/false);
+                if (needed[i] && (iteration % power_2) % kl == 0) {
+                    if (stopped) return y;
+                    weso->SetIntermediate(iteration, i, y);
                 }
             }
             nudupl_form(y, y, D, L);
             reducer.reduce(y);
         }
         AddIntermediates(iter_begin);
+        return y;
+    }
+
+    // Prepares a resumed session whose VDF loop starts at iteration, a
+    // multiple of 2^16; call before the loop starts. Bucket i needs the
+    // intermediates from intermediates_begin[i] on: the blocks before
+    // iteration are recomputed from checkpoints, and segments are reported
+    // finished only once they are.
+    void ResumeAt(uint64_t iteration, const std::vector<form>& checkpoints,
+                  const std::vector<uint64_t>& intermediates_begin) {
+        uint64_t begin = iteration;
+        for (uint64_t b : intermediates_begin)
+            begin = std::min(begin, b);
+        {
+            std::lock_guard<std::mutex> lk(intermediates_mutex);
+            this->intermediates_begin = intermediates_begin;
+            resume_iteration = iteration;
+            intermediates_iter = begin;
+            // The second half of each block is queued once its first half
+            // yields the form there.
+            for (uint64_t block = begin; block < iteration; block += (1 << 16))
+                pending_intermediates[block] = checkpoints[block >> 16];
+            UpdateTargetLocked();
+        }
+        intermediates_cv.notify_all();
     }
 
+    // Called by the VDF loop every 2^15 iterations with the form there; queues
+    // the block and measures the loop's rate.
     void SubmitCheckpoint(form y_ret, uint64_t iteration) {
+        auto now = std::chrono::steady_clock::now();
         {
             std::lock_guard<std::mutex> lk(intermediates_mutex);
             pending_intermediates[iteration] = y_ret;
+            if (last_checkpoint_time != std::chrono::steady_clock::time_point()) {
+                UpdateAverage(checkpoint_seconds, std::chrono::duration<double>(now - last_checkpoint_time).count());
+            }
+            last_checkpoint_time = now;
+            UpdateTargetLocked();
         }
         intermediates_cv.notify_all();
     }
 
     uint64_t GetFinishedSegment() {
-        while (intermediates_stored[2 * (intermediates_iter / (1 << 16))] == true &&
-               intermediates_stored[2 * (intermediates_iter / (1 << 16)) + 1] == true) {
-                    intermediates_iter += (1 << 16);
-                }
+        while (IsSegmentStored(intermediates_iter / (1 << 16))) {
+            intermediates_iter += (1 << 16);
+        }
         return intermediates_iter;
     }
 
-    void CalculateIntermediatesThread() {
+    void CalculateIntermediatesThread(int index) {
+        PinWorkerThread();
         while (!stopped) {
-            {
-                std::unique_lock<std::mutex> lk(intermediates_mutex);
-                intermediates_cv.wait(lk, [&] {
-                    return (!pending_intermediates.empty() || stopped);
-                });
-                if (!stopped) {
-                    uint64_t iter_begin = (*pending_intermediates.begin()).first;
-                    form y = (*pending_intermediates.begin()).second;
-                    pending_intermediates.erase(pending_intermediates.begin());
-                    lk.unlock();
-                    CalculateIntermediatesInner(y, iter_begin);
-                }
+            std::unique_lock<std::mutex> lk(intermediates_mutex);
+            // Workers beyond the target park until it grows again.
+            intermediates_cv.wait(lk, [&] {
+                return (!pending_intermediates.empty() && index < target_threads) || stopped;
+            });
+            if (stopped)
+                return;
+            uint64_t iter_begin = (*pending_intermediates.begin()).first;
+            form y = (*pending_intermediates.begin()).second;
+            pending_intermediates.erase(pending_intermediates.begin());
+            lk.unlock();
+
+            auto begin = std::chrono::steady_clock::now();
+            form y_end = CalculateIntermediatesInner(y, iter_begin);
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            lk.lock();
+            // A block cut short by the destructor is no sample.
+            if (stopped)
+                return;
+            if (iter_begin < resume_iteration && iter_begin % (1 << 16) == 0) {
+                pending_intermediates[iter_begin + (1 << 15)] = y_end;
+                intermediates_cv.notify_all();
             }
+            UpdateAverage(block_seconds, elapsed);
+            UpdateTargetLocked();
         }
     }
 
   private:
+    static const int kStoredWords = (1 << 19) / 64;
+
+    bool IsSegmentStored(uint64_t bucket) {
+        uint64_t pair = uint64_t(3) << (2 * bucket % 64);
+        return (intermediates_stored[2 * bucket / 64].load(std::memory_order_acquire) & pair) == pair;
+    }
+
+    // Exponential moving average over roughly the last 8 samples.
+    static void UpdateAverage(double& average, double sample) {
+        average = (average == 0) ? sample : average + (sample - average) / 8;
+    }
+
+    void UpdateTargetLocked() {
+        int target = ComputeTargetThreads(block_seconds, checkpoint_seconds, pending_intermediates.size(),
+                                          target_threads, kMinIntermediatesThreads, max_threads);
+        if (target == target_threads)
+            return;
+        target_threads = target;
+        SpawnThreadsLocked();
+        intermediates_cv.notify_all();
+    }
+
+    // Threads are started on demand and parked, not joined, when the
+    // target shrinks.
+    void SpawnThreadsLocked() {
+        while (!stopped && static_cast<int>(storage_threads.size()) < target_threads) {
+            int index = static_cast<int>(storage_threads.size());
+            storage_threads.push_back(std::thread([=] { CalculateIntermediatesThread(index); }));
+        }
+    }
+
     std::vector<std::thread> storage_threads;
     FastAlgorithmCallback* weso;
-    bool* intermediates_stored;
-    bool stopped;
+    // Two bits per 2^16 segment, one per 2^15 half.
+    std::unique_ptr<std::atomic<uint64_t>[]> intermediates_stored;
+    std::atomic<bool> stopped;
     std::map<uint64_t, form> pending_intermediates;
-    int intermediates_threads = 6;
+    // Set by ResumeAt() before any block is queued.
+    std::vector<uint64_t> intermediates_begin;
+    uint64_t resume_iteration = 0;
+    // Guarded by intermediates_mutex.
+    int target_threads;
+    int max_threads;
+    double block_seconds = 0;
+    double checkpoint_seconds = 0;
+    std::chrono::steady_clock::time_point last_checkpoint_time;
     std::mutex intermediates_mutex;
     std::condition_variable intermediates_cv;
     uint64_t intermediates_iter = 0;
@@ -0,0 +1,89 @@
+#include "create_discriminant.h"
+#include "vdf.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+integer get_fast_storage_discriminant() {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    return CreateDiscriminant(challenge_hash, 1024);
+}
+
+}  // namespace
+
+TEST(FastStorageRegressionTest, TargetThreadsFollowRatesAndBacklog) {
+    // No measurements yet: keep the current count.
+    EXPECT_EQ(FastStorage::ComputeTargetThreads(0, 0, 0, 6, 2, 8), 6);
+    // Recompute is 3x slower than squaring: 3 * 1.25 rounds up to 4.
+    EXPECT_EQ(FastStorage::ComputeTargetThreads(3.0, 1.0, 0, 6, 2, 8), 4);
+    // A backlog larger than the pool adds a worker.
+    EXPECT_EQ(FastStorage::ComputeTargetThreads(3.0, 1.0, 10, 6, 2, 8), 5);
+    // Clamped to the bounds.
+    EXPECT_EQ(FastStorage::ComputeTargetThreads(0.1, 1.0, 0, 6, 2, 8), 2);
+    EXPECT_EQ(FastStorage::ComputeTargetThreads(30.0, 1.0, 100, 6, 2, 8), 8);
+}
+
+TEST(FastStorageRegressionTest, SegmentFinishesWhenBothHalvesAreStored) {
+    integer d = get_fast_storage_discriminant();
+    form f = form::generator(d);
+    FastAlgorithmCallback weso(2, d, f, true);
+    FastStorage storage(&weso);
+    EXPECT_GE(storage.GetTargetThreads(), kMinIntermediatesThreads);
+
+    EXPECT_EQ(storage.GetFinishedSegment(), 0u);
+    storage.AddIntermediates(1 << 15);
+    EXPECT_EQ(storage.GetFinishedSegment(), 0u);
+    storage.AddIntermediates(0);
+    EXPECT_EQ(storage.GetFinishedSegment(), uint64_t(1) << 16);
+
+    // Segments later in the same bitmap word wait for the gap to fill.
+    storage.AddIntermediates(uint64_t(2) << 16);
+    storage.AddIntermediates((uint64_t(2) << 16) + (1 << 15));
+    EXPECT_EQ(storage.GetFinishedSegment(), uint64_t(1) << 16);
+    storage.AddIntermediates(uint64_t(1) << 16);
+    storage.AddIntermediates((uint64_t(1) << 16) + (1 << 15));
+    EXPECT_EQ(storage.GetFinishedSegment(), uint64_t(3) << 16);
+
+    // Bucket 40 lives in the second bitmap word.
+    storage.AddIntermediates(uint64_t(40) << 16);
+    storage.AddIntermediates((uint64_t(40) << 16) + (1 << 15));
+    EXPECT_EQ(storage.GetFinishedSegment(), uint64_t(3) << 16);
+}
+
+TEST(FastStorageRegressionTest, ResumeRecomputesOnlyTheUnprovenBuckets) {
+    integer d = get_fast_storage_discriminant();
+    form f = form::generator(d);
+    const uint64_t resume = uint64_t(2) << 16;
+    // What the VDF loop would have stored before the interruption.
+    FastAlgorithmCallback expected(2, d, f, false);
+    std::vector<form> checkpoints(1, f);
+    integer L = root(-d, 4);
+    PulmarkReducer reducer;
+    form y = f;
+    for (uint64_t i = 0; i < resume; i++) {
+        nudupl_form(y, y, d, L);
+        reducer.reduce(y);
+        expected.OnIteration(NL_FORM, &y, i);
+        if ((i + 1) % (1 << 16) == 0)
+            checkpoints.push_back(y);
+    }
+
+    FastAlgorithmCallback weso(2, d, f, true);
+    form marker = checkpoints[1];
+    weso.SetIntermediate(10, 0, marker);
+    FastStorage storage(&weso);
+    // The 2^16 segments before resume are proven, the 2^18 one is not.
+    storage.ResumeAt(resume, checkpoints, {resume, 0});
+    while (storage.GetFinishedSegment() < resume)
+        std::this_thread::yield();
+
+    EXPECT_EQ(weso.GetForm(10, 0), marker);
+    for (uint64_t i = 0; i < resume; i += 12 * 1000)
+        EXPECT_EQ(weso.GetForm(i, 1), expected.GetForm(i, 1)) << "iteration " << i;
+    EXPECT_EQ(weso.GetForm(resume - 8, 1), expected.GetForm(resume - 8, 1));
+}
@@ -0,0 +1,159 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// HashPrime before candidates were batched: one candidate at a time through
+// integer::prime() with the gcd-based trial division.
+integer reference_hash_prime(std::vector<uint8_t> seed, int length, vector<int> bitmask) {
+    std::vector<uint8_t> hash(picosha2::k_digest_size);
+    std::vector<uint8_t> blob;
+    std::vector<uint8_t> sprout = seed;
+
+    while (true) {
+        blob.resize(0);
+        while ((int) blob.size() * 8 < length) {
+            for (int i = (int) sprout.size() - 1; i >= 0; --i) {
+                sprout[i]++;
+                if (sprout[i])
+                    break;
+            }
+            picosha2::hash256(sprout.begin(), sprout.end(), hash.begin(), hash.end());
+            blob.insert(blob.end(), hash.begin(),
+                hash.begin() + std::min(hash.size(), length / 8 - blob.size()));
+        }
+        integer p(blob);
+        for (int b: bitmask)
+            p.set_bit(b, true);
+        p.set_bit(0, true);
+
+        bool composite = false;
+        for (int i = 0; i < bpsw_pprods_count(p.impl); i++) {
+            if (mpn_gcd_1(p.impl->_mp_d, p.impl->_mp_size, pprods[i]) != 1) {
+                composite = true;
+                break;
+            }
+        }
+        if (!composite && is_bpsw_probable_prime(p.impl))
+            return p;
+    }
+}
+
+std::vector<uint8_t> hash_prime_seed(int i) {
+    return std::vector<uint8_t>({0, 0, 1, 2, 3, 3, 4, uint8_t(i), uint8_t(i >> 8)});
+}
+
+}  // namespace
+
+TEST(HashPrimeRegressionTest, MatchesOneCandidateAtATime) {
+    for (int i = 0; i < 40; i++) {
+        std::vector<uint8_t> seed = hash_prime_seed(i);
+        EXPECT_EQ(HashPrime(seed, B_bits, {B_bits - 1}), reference_hash_prime(seed, B_bits, {B_bits - 1}))
+            << "B seed " << i;
+    }
+    for (int i = 0; i < 8; i++) {
+        std::vector<uint8_t> seed = hash_prime_seed(i);
+        EXPECT_EQ(HashPrime(seed, 1024, {0, 1, 2, 1023}), reference_hash_prime(seed, 1024, {0, 1, 2, 1023}))
+            << "discriminant seed " << i;
+    }
+}
+
+TEST(HashPrimeRegressionTest, SmallFactorsMatchGcd) {
+    integer n(1);
+    for (int i = 0; i < 2000; i++) {
+        // Odd values around all the limb sizes the pprods count depends on.
+        integer x = (n << (i % 1100)) + integer(2 * i + 3);
+        int n_pprods = bpsw_pprods_count(x.impl);
+        int expected = 0;
+        for (int j = 0; j < n_pprods; j++)
+            expected |= mpn_gcd_1(x.impl->_mp_d, x.impl->_mp_size, pprods[j]) != 1;
+        EXPECT_EQ(has_small_factor(x.impl, n_pprods), expected) << x.to_string();
+    }
+}
+
+TEST(HashPrimeRegressionTest, StatsCountCandidatesUpToThePrime) {
+    std::vector<uint8_t> seed = hash_prime_seed(7);
+    HashPrimeStats stats;
+    integer p = HashPrime(seed, 1024, {0, 1, 2, 1023}, &stats);
+
+    EXPECT_TRUE(p.prime());
+    EXPECT_GE(stats.candidates, 1u);
+    EXPECT_EQ(stats.candidates, stats.small_factor_rejects + stats.probable_prime_tests);
+    EXPECT_GE(stats.probable_prime_tests, 1u);
+}
+
+TEST(HashPrimeRegressionTest, BackendsGiveTheSameDiscriminantsAndB) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form y = form::generator(d);
+    for (Sha256Backend backend : {Sha256Backend::kScalar, Sha256Backend::kAvx2}) {
+        if (!IsSha256BackendAvailable(backend))
+            continue;
+        for (int i = 0; i < 4; i++) {
+            std::vector<uint8_t> seed = hash_prime_seed(i);
+            EXPECT_EQ(HashPrime(seed, 1024, {0, 1, 2, 1023}, nullptr, backend),
+                      reference_hash_prime(seed, 1024, {0, 1, 2, 1023}))
+                << "backend " << int(backend) << ", discriminant seed " << i;
+        }
+        // GetB's seed: two serialized forms.
+        form x = form::generator(d);
+        for (int i = 0; i < 8; i++) {
+            x = x * y;
+            std::vector<uint8_t> serialization = SerializeForm(x, d.num_bits());
+            std::vector<uint8_t> y_serialization = SerializeForm(y, d.num_bits());
+            serialization.insert(serialization.end(), y_serialization.begin(), y_serialization.end());
+            EXPECT_EQ(HashPrime(serialization, B_bits, {B_bits - 1}, nullptr, backend),
+                      reference_hash_prime(serialization, B_bits, {B_bits - 1}))
+                << "backend " << int(backend) << ", B seed " << i;
+        }
+    }
+}
+
+TEST(HashPrimeRegressionTest, AddToSproutMatchesIncrements) {
+    for (uint64_t n : {uint64_t(0), uint64_t(1), uint64_t(255), uint64_t(256), uint64_t(1000), uint64_t(70000)}) {
+        std::vector<uint8_t> sprout({0, 7, 0xff, 0xfe, 0x80});
+        std::vector<uint8_t> expected = sprout;
+        AddToSprout(sprout, n);
+        for (uint64_t k = 0; k < n; k++) {
+            for (int i = (int) expected.size() - 1; i >= 0; --i) {
+                expected[i]++;
+                if (expected[i])
+                    break;
+            }
+        }
+        EXPECT_EQ(sprout, expected) << n;
+    }
+    // Wraps around like the increments do.
+    std::vector<uint8_t> sprout({0xff, 0xff});
+    AddToSprout(sprout, 3);
+    EXPECT_EQ(sprout, std::vector<uint8_t>({0, 2}));
+}
+
+TEST(HashPrimeRegressionTest, ParallelSearchReturnsTheFirstPrime) {
+    for (int num_threads : {2, 3, 5}) {
+        for (int i = 0; i < 6; i++) {
+            std::vector<uint8_t> seed = hash_prime_seed(i);
+            EXPECT_EQ(HashPrimeParallel(seed, 1024, {0, 1, 2, 1023}, num_threads),
+                      HashPrime(seed, 1024, {0, 1, 2, 1023}))
+                << num_threads << " threads, discriminant seed " << i;
+            EXPECT_EQ(HashPrimeParallel(seed, B_bits, {B_bits - 1}, num_threads),
+                      HashPrime(seed, B_bits, {B_bits - 1}))
+                << num_threads << " threads, B seed " << i;
+        }
+    }
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    EXPECT_EQ(CreateDiscriminant(challenge_hash, 1024, 0), CreateDiscriminant(challenge_hash, 1024));
+}
+
+TEST(HashPrimeRegressionTest, ParallelSearchBoundsTheThreadCount) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    // Capped to the hardware threads rather than starting 10000 of them.
+    EXPECT_EQ(CreateDiscriminant(challenge_hash, 1024, 10000), CreateDiscriminant(challenge_hash, 1024));
+    EXPECT_THROW(CreateDiscriminant(challenge_hash, 1024, -1), std::invalid_argument);
+    EXPECT_THROW(HashPrimeParallel(hash_prime_seed(0), B_bits, {B_bits - 1}, -2), std::invalid_argument);
+}
@@ -0,0 +1,134 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+#include "prover_slow.h"
+#include "alloc.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+integer get_arena_discriminant() {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    return CreateDiscriminant(challenge_hash, 1024);
+}
+
+}  // namespace
+
+TEST(MpArenaRegressionTest, InactiveWithoutCustomAllocator) {
+    void* (*alloc_func)(size_t);
+    mp_get_memory_functions(&alloc_func, nullptr, nullptr);
+    if (alloc_func == mp_alloc_func) {
+        GTEST_SKIP() << "custom GMP allocator already installed";
+    }
+    ScopedMpArena arena;
+    EXPECT_FALSE(arena.IsActive());
+}
+
+TEST(MpArenaRegressionTest, ProveSlowMatchesWithArena) {
+    integer d = get_arena_discriminant();
+    form x = form::generator(d);
+    const uint64_t iters = 5000;
+
+    // Runs before any other test installs the custom allocator.
+    std::vector<uint8_t> expected = ProveSlow(d, x, iters, "");
+    init_gmp();
+    std::vector<uint8_t> actual = ProveSlow(d, x, iters, "");
+    EXPECT_EQ(actual, expected);
+
+    form y = DeserializeForm(d, actual.data(), BQFC_FORM_SIZE);
+    form proof = DeserializeForm(d, actual.data() + BQFC_FORM_SIZE, BQFC_FORM_SIZE);
+    bool is_valid = false;
+    VerifyWesolowskiProof(d, x, y, proof, iters, is_valid);
+    EXPECT_TRUE(is_valid);
+}
+
+TEST(MpArenaRegressionTest, BlocksAreRecycledAndGrowInPlace) {
+    init_gmp();
+    ScopedMpArena arena;
+    ASSERT_TRUE(arena.IsActive());
+
+    void* a = mp_alloc_func(40);
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(std::uintptr_t(a) & 15, 8u);
+    EXPECT_EQ(MpArena::Owner(a), mp_current_arena);
+    EXPECT_GE(MpArena::Capacity(a), 40u);
+
+    // Growing within the size class keeps the block.
+    EXPECT_EQ(mp_realloc_func(a, 40, MpArena::Capacity(a)), a);
+    mp_free_func(a, MpArena::Capacity(a));
+    void* b = mp_alloc_func(40);
+    EXPECT_EQ(a, b);
+    mp_free_func(b, 40);
+
+    // Requests above the largest class fall back to the heap.
+    void* big = mp_alloc_func(size_t(1) << 16);
+    ASSERT_NE(big, nullptr);
+    EXPECT_EQ(std::uintptr_t(big) & 15, 8u);
+    EXPECT_EQ(MpArena::Owner(big), nullptr);
+    mp_free_func(big, size_t(1) << 16);
+}
+
+TEST(MpArenaRegressionTest, BlocksOutliveScopeAndCrossThreads) {
+    init_gmp();
+    integer survivor;
+    std::vector<integer> values;
+    {
+        ScopedMpArena arena;
+        ASSERT_TRUE(arena.IsActive());
+        survivor = integer("0x123456789abcdef0123456789abcdef0123456789abcdef");
+        for (int i = 0; i < 64; i++) {
+            values.push_back(survivor * integer(i + 1));
+        }
+    }
+    EXPECT_EQ(mp_current_arena, nullptr);
+
+    // The arena is kept alive by its outstanding blocks, which other threads
+    // may free.
+    std::thread t([&values]() { values.clear(); });
+    t.join();
+    EXPECT_EQ(survivor * integer(3), survivor + survivor + survivor);
+}
+
+TEST(MpArenaRegressionTest, LargeBufferIsZeroedInEveryMode) {
+    const size_t bytes = 3 * kHugePageBytes + 123;
+    for (HugePageMode mode : {HugePageMode::kOff, HugePageMode::kTransparent, HugePageMode::kHugetlb}) {
+        LargeBuffer buffer(bytes, /*zeroed=*/true, mode);
+        uint8_t* data = static_cast<uint8_t*>(buffer.get());
+        ASSERT_NE(data, nullptr);
+        EXPECT_EQ(data[0], 0);
+        EXPECT_EQ(data[bytes - 1], 0);
+        data[bytes - 1] = 1;
+#if defined(__linux__)
+        // hugetlb falls back to a transparent huge page mapping when the
+        // reserved pool is empty.
+        EXPECT_EQ(buffer.IsHugePageBacked(), mode != HugePageMode::kOff);
+        if (buffer.IsHugePageBacked()) {
+            EXPECT_EQ(std::uintptr_t(data) % kHugePageBytes, 0u);
+        }
+#endif
+    }
+
+    // Small requests never take a huge page.
+    LargeBuffer small(4096, /*zeroed=*/false, HugePageMode::kTransparent);
+    EXPECT_FALSE(small.IsHugePageBacked());
+}
+
+TEST(MpArenaRegressionTest, LargeArrayHoldsForms) {
+    integer d = get_arena_discriminant();
+    form x = form::generator(d);
+    LargeArray<form> forms;
+    forms.reset(100000);
+    ASSERT_EQ(forms.size(), 100000u);
+    forms[0] = x;
+    forms[99999] = x;
+    EXPECT_TRUE(forms[99999] == x);
+    EXPECT_TRUE(forms[1].a == integer(0));
+    // Resetting destroys the old forms and starts over.
+    forms.reset(10);
+    EXPECT_EQ(forms.size(), 10u);
+    EXPECT_TRUE(forms[0].a == integer(0));
+}
@@ -84,6 +84,31 @@ inline bool env_flag(const char* name) {
   return true;
 }
 
+// Parses an unsigned decimal environment variable; returns default_value if
+// it is unset, empty or malformed.
+inline uint32_t env_uint32(const char* name, uint32_t default_value) {
+#if defined(_WIN32)
+  char* value = nullptr;
+  size_t value_len = 0;
+  if (_dupenv_s(&value, &value_len, name) != 0 || value == nullptr) {
+    return default_value;
+  }
+  std::string str(value);
+  free(value);
+#else
+  const char* value = getenv(name);
+  if (!value) {
+    return default_value;
+  }
+  std::string str(value);
+#endif
+  if (str.empty() || str.size() > 9 ||
+      str.find_first_not_of("0123456789") != std::string::npos) {
+    return default_value;
+  }
+  return static_cast<uint32_t>(std::stoul(str));
+}
+
 inline bool should_log_avx() {
   return env_flag("CHIAVDF_LOG_AVX");
 }
@@ -4,6 +4,9 @@
 #include "checked_cast.h"
 #include "pprods.h"
 
+#include <cstdint>
+#include <vector>
+
 static int miller_rabin(const mpz_t n, mpz_t b, mpz_t d)
 {
     int r = 0;
@@ -128,28 +131,47 @@ out:
     return res;
 }
 
-/*
- * This is a "strengthened" Baillie-PSW primality test based on "Strengthening
- * the Baillie-PSW primality test" paper (https://arxiv.org/abs/2006.14425).
- *
- * The primality test consists of 3 steps:
- * 1. Compute GCDs of n (the number being tested) and products of small primes.
- * Declare n to be composite if any of those GCDs is not equal to 1. For a
- * randomly generated odd n of 1024 bits in length, the test ends here in 88%
- * of cases, and it's substantially faster than running a single round of
- * Miller-Rabin test.
- * 2. Do a single round of Miller-Rabin test with base 2.
- * 3. Do the Lucas-V Probable Prime test (vprp).
- */
-static int is_prime_bpsw(const mpz_t n)
+/* The odd primes of each pprods entry, with their inverses mod 2^64, so that
+ * divisibility by each prime of a product can be read off the remainder
+ * modulo the product with one multiplication per prime. */
+struct small_prime_table {
+    /* primes of pprods[i] are at [offsets[i], offsets[i + 1]) */
+    std::vector<int> offsets;
+    std::vector<uint64_t> inverses;
+    /* floor((2^64 - 1) / p) */
+    std::vector<uint64_t> limits;
+};
+
+static const small_prime_table& get_small_prime_table()
 {
-    int i, ret = 0;
-    int min_pprods = 5, n_pprods = sizeof(pprods) / sizeof(*pprods);
-    mpz_t b, d;
+    static const small_prime_table table = [] {
+        small_prime_table t;
+        uint64_t p = 3;
+        for (uint64_t prod : pprods) {
+            t.offsets.push_back((int)t.inverses.size());
+            /* pprods are products of consecutive odd primes. */
+            for (; prod > 1; p += 2) {
+                if (prod % p)
+                    continue;
+                prod /= p;
+                /* Newton iteration for p^-1 mod 2^64; p*p = 1 mod 8. */
+                uint64_t inv = p;
+                for (int i = 0; i < 5; i++)
+                    inv *= 2 - p * inv;
+                t.inverses.push_back(inv);
+                t.limits.push_back(UINT64_MAX / p);
+            }
+        }
+        t.offsets.push_back((int)t.inverses.size());
+        return t;
+    }();
+    return table;
+}
 
-    /* Discard even numbers. */
-    if (!mpz_tstbit(n, 0) && mpz_cmp_ui(n, 2))
-        return 0;
+/* Number of pprods entries the trial division of is_prime_bpsw uses for n. */
+static int bpsw_pprods_count(const mpz_t n)
+{
+    int min_pprods = 5, n_pprods = sizeof(pprods) / sizeof(*pprods);
 
     /* Adjust the number of GCDs to compute with products of small primes
      * if bit length of n is less than 1024. As the computational cost of
@@ -159,11 +181,30 @@ static int is_prime_bpsw(const mpz_t n)
         int size_cube = n->_mp_size * n->_mp_size * n->_mp_size;
         n_pprods = min_pprods + (n_pprods - min_pprods) * size_cube / (16*16*16);
     }
+    return n_pprods;
+}
 
-    for (i = 0; i < n_pprods; i++) {
-        if (mpn_gcd_1(n->_mp_d, n->_mp_size, pprods[i]) != 1)
-            return 0;
+/* Nonzero iff gcd(n, pprods[i]) != 1 for some i < n_pprods, i.e. n is
+ * divisible by one of their primes. n must be positive. */
+static int has_small_factor(const mpz_t n, int n_pprods)
+{
+    const small_prime_table& t = get_small_prime_table();
+    for (int i = 0; i < n_pprods; i++) {
+        uint64_t r = mpn_mod_1(n->_mp_d, n->_mp_size, pprods[i]);
+        for (int j = t.offsets[i]; j < t.offsets[i + 1]; j++) {
+            if (r * t.inverses[j] <= t.limits[j])
+                return 1;
+        }
     }
+    return 0;
+}
+
+/* Steps 2 and 3 of is_prime_bpsw on mpz arithmetic, for an odd n without
+ * small factors. */
+static int is_bpsw_probable_prime_gmp(const mpz_t n)
+{
+    int ret;
+    mpz_t b, d;
 
     mpz_init2(b, n->_mp_size * sizeof(n->_mp_d[0]) * 8);
     mpz_init2(d, n->_mp_size * sizeof(n->_mp_d[0]) * 8);
@@ -171,7 +212,260 @@ static int is_prime_bpsw(const mpz_t n)
     ret = miller_rabin(n, b, d) && is_vprp(n, b, d);
 
     mpz_clears(b, d, NULL);
-    return ret ? 2 : 0;
+    return ret;
+}
+
+/* Largest limb count of n that is_bpsw_probable_prime tests with
+ * montgomery_ctx; 1024-bit discriminants on 64-bit limbs. */
+#define BPSW_MONTGOMERY_MAX_LIMBS 16
+
+/* Montgomery arithmetic modulo an odd n of exactly N limbs, on fixed-size
+ * limb arrays. R = 2^(N * GMP_NUMB_BITS) and values are kept in [0, n). */
+template <int N>
+struct montgomery_ctx {
+    mpz_srcptr modulus; /* n as passed in */
+    mp_limb_t n[N];
+    mp_limb_t n_inv; /* -n^-1 mod 2^GMP_NUMB_BITS */
+    mp_limb_t one[N]; /* R mod n */
+
+    explicit montgomery_ctx(const mpz_t m) : modulus(m)
+    {
+        mpz_t r;
+
+        mpn_copyi(n, m->_mp_d, N);
+        /* Newton iteration for n^-1 mod 2^GMP_NUMB_BITS; n*n = 1 mod 8. */
+        mp_limb_t inv = n[0];
+        for (int i = 0; i < 5; i++)
+            inv *= 2 - n[0] * inv;
+        n_inv = -inv;
+
+        mpz_init(r);
+        mpz_setbit(r, N * GMP_NUMB_BITS);
+        mpz_mod(r, r, m);
+        mpn_zero(one, N);
+        mpn_copyi(one, r->_mp_d, r->_mp_size);
+        mpz_clear(r);
+    }
+
+    /* r = t / R mod n for t < n * R; t (2N limbs) is overwritten. */
+    void redc(mp_limb_t *r, mp_limb_t *t) const
+    {
+        for (int i = 0; i < N; i++) {
+            mp_limb_t q = t[i] * n_inv;
+            /* t[i] is now 0; keep the carry into t[i + N] there. */
+            t[i] = mpn_addmul_1(t + i, n, N, q);
+        }
+        if (mpn_add_n(r, t + N, t, N) || mpn_cmp(r, n, N) >= 0)
+            mpn_sub_n(r, r, n, N);
+    }
+
+    void mul(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b) const
+    {
+        mp_limb_t t[2 * N];
+        mpn_mul_n(t, a, b, N);
+        redc(r, t);
+    }
+
+    void sqr(mp_limb_t *r, const mp_limb_t *a) const
+    {
+        mp_limb_t t[2 * N];
+        mpn_sqr(t, a, N);
+        redc(r, t);
+    }
+
+    void add(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b) const
+    {
+        if (mpn_add_n(r, a, b, N) || mpn_cmp(r, n, N) >= 0)
+            mpn_sub_n(r, r, n, N);
+    }
+
+    void sub(mp_limb_t *r, const mp_limb_t *a, const mp_limb_t *b) const
+    {
+        if (mpn_sub_n(r, a, b, N))
+            mpn_add_n(r, r, n, N);
+    }
+
+    /* r = a * c mod n, which keeps a in Montgomery form. */
+    void mul_si(mp_limb_t *r, const mp_limb_t *a, long c) const
+    {
+        mp_limb_t t[N + 1], q[2];
+        t[N] = mpn_mul_1(t, a, N, (mp_limb_t)(c < 0 ? -c : c));
+        mpn_tdiv_qr(q, r, 0, t, N + 1, n, N);
+        if (c < 0) {
+            int i = 0;
+            while (i < N && !r[i])
+                i++;
+            if (i < N)
+                mpn_sub_n(r, n, r, N);
+        }
+    }
+
+    /* Montgomery form of c. */
+    void set_si(mp_limb_t *r, long c) const
+    {
+        mul_si(r, one, c);
+    }
+
+    /* Montgomery form of x. */
+    void set_mpz(mp_limb_t *r, const mpz_t x) const
+    {
+        mpz_t t;
+
+        mpz_init(t);
+        mpz_mul_2exp(t, x, N * GMP_NUMB_BITS);
+        mpz_mod(t, t, modulus);
+        mpn_zero(r, N);
+        mpn_copyi(r, t->_mp_d, t->_mp_size);
+        mpz_clear(t);
+    }
+};
+
+/* miller_rabin with base 2. 2^d is computed with a squaring and, for each
+ * set bit of d, a doubling, so no multiplication by the base is needed. */
+template <int N>
+static int miller_rabin_montgomery(const montgomery_ctx<N> &ctx, const mpz_t n, mpz_t d)
+{
+    mp_limb_t b[N], minus_one[N];
+    int r = 0;
+    mp_bitcnt_t s_bits = mpz_scan1(n, 1);
+    int s = checked_cast<int>(s_bits);
+
+    mpz_tdiv_q_2exp(d, n, s);
+    mpn_copyi(b, ctx.one, N);
+    for (long i = (long)mpz_sizeinbase(d, 2) - 1; i >= 0; i--) {
+        ctx.sqr(b, b);
+        if (mpz_tstbit(d, i))
+            ctx.add(b, b, b);
+    }
+    if (!mpn_cmp(b, ctx.one, N))
+        return 1;
+
+    mpn_sub_n(minus_one, ctx.n, ctx.one, N);
+    while (1) {
+        if (!mpn_cmp(b, minus_one, N))
+            return 1;
+        r++;
+        if (r == s)
+            return 0;
+        ctx.sqr(b, b);
+    }
+}
+
+/* is_vprp: V_{n+1} = 2Q (mod n), with the P and Q of find_pq. For
+ * n + 1 = 2m, V_{n+1}(P, Q) = V_m(P^2 - 2Q, Q^2) = Q^m V_m(P', 1) with
+ * P' = P^2/Q - 2, and V_k(P', 1) only needs
+ *   V_2k = V_k^2 - 2,  V_2k+1 = V_k V_k+1 - P'
+ * so each bit costs a multiplication and a squaring, plus a squaring for
+ * Q^m. n > 2|Q| since n has at least 2 limbs, so comparing residues gives
+ * the same answer as is_vprp's signed comparison. n sharing a factor with
+ * Q, which trial division has ruled out before, goes to is_vprp. */
+template <int N>
+static int is_vprp_montgomery(const montgomery_ctx<N> &ctx, const mpz_t n, mpz_t tmp1, mpz_t tmp2)
+{
+    mp_limb_t v0[N], v1[N], p1[N], two[N], qm[N];
+    int p, q;
+
+    if (find_pq(&p, &q, n, tmp1))
+        return 0;
+
+    mpz_set_si(tmp1, q);
+    if (!mpz_invert(tmp2, tmp1, n))
+        return is_vprp(n, tmp1, tmp2);
+    mpz_mul_si(tmp2, tmp2, p * p - 2 * q);
+    ctx.set_mpz(p1, tmp2);
+    ctx.set_si(two, 2);
+
+    /* m = (n + 1) / 2 */
+    mpz_add_ui(tmp1, n, 1);
+    mpz_tdiv_q_2exp(tmp1, tmp1, 1);
+    /* (V_k, V_k+1) for k = 0, and Q^k */
+    mpn_copyi(v0, two, N);
+    mpn_copyi(v1, p1, N);
+    mpn_copyi(qm, ctx.one, N);
+    for (long i = (long)mpz_sizeinbase(tmp1, 2) - 1; i >= 0; i--) {
+        ctx.sqr(qm, qm);
+        if (mpz_tstbit(tmp1, i)) {
+            ctx.mul_si(qm, qm, q);
+            ctx.mul(v0, v0, v1);
+            ctx.sub(v0, v0, p1);    /* V_2k+1 */
+            ctx.sqr(v1, v1);
+            ctx.sub(v1, v1, two);   /* V_2k+2 */
+        } else {
+            ctx.mul(v1, v0, v1);
+            ctx.sub(v1, v1, p1);    /* V_2k+1 */
+            ctx.sqr(v0, v0);
+            ctx.sub(v0, v0, two);   /* V_2k */
+        }
+    }
+    ctx.mul(v0, v0, qm);
+    ctx.set_si(v1, 2 * q);
+    return !mpn_cmp(v0, v1, N);
+}
+
+template <int N>
+static int is_bpsw_probable_prime_montgomery(const mpz_t n)
+{
+    int ret;
+    mpz_t b, d;
+    montgomery_ctx<N> ctx(n);
+
+    mpz_init2(b, N * GMP_NUMB_BITS);
+    mpz_init2(d, N * GMP_NUMB_BITS);
+    ret = miller_rabin_montgomery(ctx, n, d) && is_vprp_montgomery(ctx, n, b, d);
+    mpz_clears(b, d, NULL);
+    return ret;
+}
+
+/* Calls is_bpsw_probable_prime_montgomery<N> for the N of n, N <= MaxN. */
+template <int MaxN>
+static int is_bpsw_probable_prime_fixed(const mpz_t n)
+{
+    if (n->_mp_size == MaxN)
+        return is_bpsw_probable_prime_montgomery<MaxN>(n);
+    return is_bpsw_probable_prime_fixed<MaxN - 1>(n);
+}
+
+template <>
+inline int is_bpsw_probable_prime_fixed<1>(const mpz_t n)
+{
+    return is_bpsw_probable_prime_gmp(n);
+}
+
+/* Steps 2 and 3 of is_prime_bpsw, for an odd n without small factors. n of
+ * 2 to BPSW_MONTGOMERY_MAX_LIMBS limbs is tested with fixed-size Montgomery
+ * arithmetic, which gives the same answer as is_bpsw_probable_prime_gmp
+ * without its allocations and divisions. */
+static int is_bpsw_probable_prime(const mpz_t n)
+{
+    if (n->_mp_size < 2 || n->_mp_size > BPSW_MONTGOMERY_MAX_LIMBS || !mpz_tstbit(n, 0))
+        return is_bpsw_probable_prime_gmp(n);
+    return is_bpsw_probable_prime_fixed<BPSW_MONTGOMERY_MAX_LIMBS>(n);
+}
+
+/*
+ * This is a "strengthened" Baillie-PSW primality test based on "Strengthening
+ * the Baillie-PSW primality test" paper (https://arxiv.org/abs/2006.14425).
+ *
+ * The primality test consists of 3 steps:
+ * 1. Compute GCDs of n (the number being tested) and products of small primes.
+ * Declare n to be composite if any of those GCDs is not equal to 1. For a
+ * randomly generated odd n of 1024 bits in length, the test ends here in 88%
+ * of cases, and it's substantially faster than running a single round of
+ * Miller-Rabin test. The GCDs are decided prime by prime from n's remainder
+ * modulo each product (has_small_factor), which is cheaper than a binary GCD.
+ * 2. Do a single round of Miller-Rabin test with base 2.
+ * 3. Do the Lucas-V Probable Prime test (vprp).
+ */
+static int is_prime_bpsw(const mpz_t n)
+{
+    /* Discard even numbers. */
+    if (!mpz_tstbit(n, 0) && mpz_cmp_ui(n, 2))
+        return 0;
+
+    if (has_small_factor(n, bpsw_pprods_count(n)))
+        return 0;
+
+    return is_bpsw_probable_prime(n) ? 2 : 0;
 }
 
 #endif // PRIMETEST_H
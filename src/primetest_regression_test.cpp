@@ -0,0 +1,91 @@
+#include "verifier.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+// Odd numbers of `limbs` limbs: random ones, primes, semiprimes that fail
+// Miller-Rabin, and prime squares, for which find_pq finds no D.
+std::vector<integer> primetest_inputs(gmp_randstate_t state, int limbs, int count) {
+    std::vector<integer> inputs;
+    int bits = limbs * GMP_NUMB_BITS;
+    for (int i = 0; i < count; i++) {
+        integer n;
+        mpz_urandomb(n.impl, state, bits);
+        mpz_setbit(n.impl, bits - 1);
+        mpz_setbit(n.impl, 0);
+        inputs.push_back(n);
+        integer p;
+        if (i % 8 == 0) {
+            mpz_nextprime(p.impl, n.impl);
+            if (p.num_bits() == bits)
+                inputs.push_back(p);
+        }
+        if (i % 8 == 1) {
+            integer q;
+            mpz_urandomb(p.impl, state, bits / 2);
+            mpz_setbit(p.impl, bits / 2 - 1);
+            mpz_nextprime(p.impl, p.impl);
+            mpz_tdiv_q(q.impl, n.impl, p.impl);
+            mpz_nextprime(q.impl, q.impl);
+            mpz_mul(n.impl, p.impl, q.impl);
+            if (n.num_bits() == bits)
+                inputs.push_back(n);
+            mpz_mul(n.impl, p.impl, p.impl);
+            if (n.num_bits() == bits)
+                inputs.push_back(n);
+        }
+    }
+    return inputs;
+}
+
+}  // namespace
+
+TEST(PrimetestRegressionTest, MontgomeryMatchesGmp) {
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 7);
+    int primes = 0;
+    // One limb and BPSW_MONTGOMERY_MAX_LIMBS + 1 take the mpz path.
+    for (int limbs = 1; limbs <= BPSW_MONTGOMERY_MAX_LIMBS + 1; limbs++) {
+        for (integer& n : primetest_inputs(state, limbs, limbs <= 5 ? 400 : 100)) {
+            int expected = is_bpsw_probable_prime_gmp(n.impl);
+            primes += expected;
+            ASSERT_EQ(is_bpsw_probable_prime(n.impl), expected) << n.to_string();
+            ASSERT_EQ(is_prime_bpsw(n.impl) != 0,
+                      expected && !has_small_factor(n.impl, bpsw_pprods_count(n.impl))) << n.to_string();
+        }
+    }
+    EXPECT_GT(primes, 0);
+    gmp_randclear(state);
+}
+
+TEST(PrimetestRegressionTest, LucasMatchesGmpWithoutMillerRabin) {
+    // Most inputs here fail Miller-Rabin, so check the Lucas step alone,
+    // including n with small factors and Q not invertible mod n.
+    gmp_randstate_t state;
+    gmp_randinit_default(state);
+    gmp_randseed_ui(state, 11);
+    mpz_t tmp1, tmp2;
+    mpz_inits(tmp1, tmp2, NULL);
+    for (integer& n : primetest_inputs(state, 5, 300)) {
+        montgomery_ctx<5> ctx(n.impl);
+        EXPECT_EQ(is_vprp_montgomery(ctx, n.impl, tmp1, tmp2), is_vprp(n.impl, tmp1, tmp2)) << n.to_string();
+    }
+    for (int q : {3, 5, 7, 11, 13}) {
+        // n = q * k, so the Q of find_pq may share a factor with n.
+        for (int k = 0; k < 50; k++) {
+            integer n;
+            mpz_urandomb(n.impl, state, 5 * GMP_NUMB_BITS - 8);
+            mpz_setbit(n.impl, 5 * GMP_NUMB_BITS - 9);
+            mpz_setbit(n.impl, 0);
+            mpz_mul_ui(n.impl, n.impl, q);
+            montgomery_ctx<5> ctx(n.impl);
+            EXPECT_EQ(is_vprp_montgomery(ctx, n.impl, tmp1, tmp2), is_vprp(n.impl, tmp1, tmp2)) << n.to_string();
+        }
+    }
+    mpz_clears(tmp1, tmp2, NULL);
+    gmp_randclear(state);
+}
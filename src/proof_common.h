@@ -2,45 +2,205 @@
 #define PROOF_COMMON_H
 #include "Reducer.h"
 #include "bqfc.c"
+#include "picosha2.h"
+#include "sha256_multibuffer.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 
 const int B_bits = 264;
 const int B_bytes = (B_bits + 7) / 8;
 
 
+// Candidate counts of one HashPrime call, up to and including the prime it
+// returns.
+struct HashPrimeStats {
+    uint64_t candidates = 0;
+    // Rejected by trial division against pprods.
+    uint64_t small_factor_rejects = 0;
+    // Went on to Miller-Rabin and Lucas.
+    uint64_t probable_prime_tests = 0;
+};
+
+// Candidates hashed and trial-divided at a time before any of them reaches
+// the Miller-Rabin test.
+const int kHashPrimeBatch = 16;
+
+// Adds n to sprout, a big-endian counter, modulo 2^(8 * sprout.size()).
+void AddToSprout(std::vector<uint8_t>& sprout, uint64_t n) {
+    unsigned carry = 0;
+    for (int i = (int) sprout.size() - 1; i >= 0 && (n || carry); --i) {
+        unsigned sum = sprout[i] + unsigned(n & 0xff) + carry;
+        sprout[i] = uint8_t(sum);
+        carry = sum >> 8;
+        n >>= 8;
+    }
+}
+
+// The candidate sequence of HashPrime, kHashPrimeBatch candidates at a time.
+// Candidate i is read from the sha256 of the sprouts that follow
+// seed + i * hashes_per_candidate.
+class HashPrimeCandidates {
+  public:
+    HashPrimeCandidates(const std::vector<uint8_t>& seed, int length, const vector<int>& bitmask,
+                        Sha256Backend backend)
+        : seed(seed), sprout(seed), bitmask(bitmask), backend(backend), batch(kHashPrimeBatch) {
+        assert (length % 8 == 0);
+        blob_size = length / 8;
+        hashes_per_candidate = (blob_size + 31) / 32;
+        hashes.resize(kHashPrimeBatch * hashes_per_candidate * 32);
+    }
+
+    // The next NextBatch() builds candidates from batch_index * kHashPrimeBatch on.
+    void Seek(uint64_t batch_index) {
+        sprout = seed;
+        AddToSprout(sprout, batch_index * kHashPrimeBatch * hashes_per_candidate);
+    }
+
+    // Builds and trial-divides the next kHashPrimeBatch candidates.
+    void NextBatch() {
+        HashCounterRun(sprout, kHashPrimeBatch * hashes_per_candidate, hashes.data(), backend);
+        for (int i = 0; i < kHashPrimeBatch; i++) {
+            integer& p = batch[i];
+            // The first blob_size bytes of the candidate's hashes.
+            const uint8_t* blob = hashes.data() + i * hashes_per_candidate * 32;
+            mpz_import(p.impl, blob_size, 1, 1, 1, 0, blob);  // p = 7 (mod 8), 2^1023 <= p < 2^1024
+            for (int b: bitmask)
+                p.set_bit(b, true);
+            // Force the number to be odd
+            p.set_bit(0, true);
+        }
+        for (int i = 0; i < kHashPrimeBatch; i++)
+            has_factor[i] = has_small_factor(batch[i].impl, bpsw_pprods_count(batch[i].impl)) != 0;
+    }
+
+    // Index in the batch of the first candidate integer::prime() accepts, or
+    // -1. Returns -1 as well once stop(i) is true for the next candidate i
+    // to go through Miller-Rabin.
+    template <class Stop>
+    int FindPrime(HashPrimeStats& counts, Stop stop) {
+        for (int i = 0; i < kHashPrimeBatch; i++) {
+            if (has_factor[i]) {
+                counts.candidates++;
+                counts.small_factor_rejects++;
+                continue;
+            }
+            if (stop(i))
+                return -1;
+            counts.candidates++;
+            counts.probable_prime_tests++;
+            if (is_bpsw_probable_prime(batch[i].impl))
+                return i;
+        }
+        return -1;
+    }
+
+    const integer& operator[](int i) const {
+        return batch[i];
+    }
+
+  private:
+    std::vector<uint8_t> seed;
+    std::vector<uint8_t> sprout;  // seed plus nonce
+    vector<int> bitmask;
+    Sha256Backend backend;
+    size_t blob_size;  // bytes of a candidate
+    size_t hashes_per_candidate;
+    // outputs of sha256, hashes_per_candidate per candidate
+    std::vector<uint8_t> hashes;
+    std::vector<integer> batch;
+    bool has_factor[kHashPrimeBatch];
+};
+
 // Generates a random pseudoprime using the hash and check method:
 // Randomly chooses x with bit-length `length`, then applies a mask
 //   (for b in bitmask) { x |= (1 << b) }.
 // Then return x if it is a pseudoprime, otherwise repeat.
-integer HashPrime(std::vector<uint8_t> seed, int length, vector<int> bitmask) {
-    assert (length % 8 == 0);
-    std::vector<uint8_t> hash(picosha2::k_digest_size);  // output of sha256
-    std::vector<uint8_t> blob;  // output of 1024 bit hash expansions
-    std::vector<uint8_t> sprout = seed;  // seed plus nonce
+//
+// Candidates are produced in batches of kHashPrimeBatch. The whole batch
+// is trial-divided first, which rejects most candidates, and the survivors
+// then go through the rest of is_prime_bpsw in order. The first survivor
+// that passes is the first candidate integer::prime() accepts, so the
+// result is the same as testing one candidate at a time. Candidates are
+// independent hashes rather than an arithmetic progression, so there is no
+// sieve to carry from one candidate to the next.
+//
+// The sprouts of a batch are hashed by one HashCounterRun; every backend
+// gives the same digests.
+integer HashPrime(std::vector<uint8_t> seed, int length, vector<int> bitmask, HashPrimeStats* stats = nullptr,
+                  Sha256Backend backend = GetDefaultSha256Backend()) {
+    HashPrimeCandidates candidates(seed, length, bitmask, backend);
+    HashPrimeStats counts;
 
     while (true) {  // While prime is not found
-        blob.resize(0);
-        while ((int) blob.size() * 8 < length) {
-            // Increment sprout by 1
-            for (int i = (int) sprout.size() - 1; i >= 0; --i) {
-                sprout[i]++;
-                if (sprout[i])
-                    break;
+        candidates.NextBatch();
+        int i = candidates.FindPrime(counts, [](int) { return false; });
+        if (i >= 0) {
+            if (stats != nullptr)
+                *stats = counts;
+            return candidates[i];
+        }
+    }
+}
+
+// Same result as HashPrime, with batches of candidates tested on
+// num_threads threads; 0 uses every hardware thread, and more threads than
+// that are capped to it. Negative counts throw std::invalid_argument. Each
+// thread takes the lowest batch nobody has taken yet. Once a prime is
+// found, candidates after it are no longer tested, while the batches before
+// it run to the end, so the lowest-index prime is returned whichever
+// thread finds a prime first.
+integer HashPrimeParallel(std::vector<uint8_t> seed, int length, vector<int> bitmask, int num_threads,
+                          Sha256Backend backend = GetDefaultSha256Backend()) {
+    if (num_threads < 0)
+        throw std::invalid_argument("HashPrimeParallel: num_threads must not be negative");
+    // Threads beyond the cores only add start-up cost to every call.
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    if (num_threads == 0 || (cores > 0 && num_threads > cores))
+        num_threads = std::max(1, cores);
+    if (num_threads == 1)
+        return HashPrime(seed, length, bitmask, nullptr, backend);
+
+    std::atomic<uint64_t> next_batch(0);
+    // Index of the lowest prime found so far.
+    std::atomic<uint64_t> best_index(UINT64_MAX);
+    std::mutex best_mutex;
+    integer best;
+
+    auto worker = [&] {
+        HashPrimeCandidates candidates(seed, length, bitmask, backend);
+        HashPrimeStats counts;
+        while (true) {
+            uint64_t batch_index = next_batch.fetch_add(1);
+            uint64_t first = batch_index * kHashPrimeBatch;
+            if (first >= best_index.load())
+                return;
+            candidates.Seek(batch_index);
+            candidates.NextBatch();
+            int i = candidates.FindPrime(counts, [&](int i) { return first + i >= best_index.load(); });
+            if (i >= 0) {
+                std::lock_guard<std::mutex> lk(best_mutex);
+                if (first + i < best_index.load()) {
+                    best = candidates[i];
+                    best_index = first + i;
+                }
+                // Batches taken later only hold higher indexes.
+                return;
             }
-            picosha2::hash256(sprout.begin(), sprout.end(), hash.begin(), hash.end());
-            // Visual Studio doesn't like pointer arithmetic past the bounds
-            blob.insert(blob.end(), hash.begin(),
-                hash.begin() + std::min(hash.size(), length / 8 - blob.size()));
         }
+    };
 
-        assert ((int) blob.size() * 8 == length);
-        integer p(blob);  // p = 7 (mod 8), 2^1023 <= p < 2^1024
-        for (int b: bitmask)
-            p.set_bit(b, true);
-        // Force the number to be odd
-        p.set_bit(0, true);
-        if (p.prime())
-            return p;
-    }
+    std::vector<std::thread> threads;
+    for (int i = 1; i < num_threads; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& t : threads)
+        t.join();
+    return best;
 }
 
 std::vector<unsigned char> SerializeForm(form &y, int d_bits)
@@ -74,12 +234,145 @@ integer FastPow(uint64_t a, uint64_t b, integer& c) {
     return res;
 }
 
+// Yields the proof digits floor(2^(T - k * (m + 1)) * 2^k / B) for blocks
+// m = first_block, first_block + stride, ... Only the first block costs a
+// modular exponentiation; after that the remainder 2^(T - k * (m + 1)) mod B
+// is stepped with a multiplication by 2^(-k * stride) mod B. B must be odd.
+// The caller must stop before T < k * (m + 1).
+class BlockDigitStream {
+  public:
+    BlockDigitStream(uint64_t first_block, uint64_t stride, uint64_t k, uint64_t T, integer& B) : k(k), B(B) {
+        if (T < k * (first_block + 1)) {
+            throw std::runtime_error("BlockDigitStream: first block out of range");
+        }
+        rem = FastPow(2, T - k * (first_block + 1), B);
+        integer step_inv = FastPow(2, k * stride, B);
+        if (mpz_invert(step.impl, step_inv.impl, B.impl) == 0) {
+            throw std::runtime_error("BlockDigitStream: modulus must be odd");
+        }
+    }
+
+    uint64_t Next() {
+        mpz_mul_2exp(digit.impl, rem.impl, k);
+        mpz_tdiv_q(digit.impl, digit.impl, B.impl);
+        mpz_mul(rem.impl, rem.impl, step.impl);
+        mpz_mod(rem.impl, rem.impl, B.impl);
+        return mpz_getlimbn(digit.impl, 0);
+    }
+
+  private:
+    uint64_t k;
+    integer& B;
+    integer rem;
+    integer step;
+    integer digit;
+};
+
+// Number of i with k * (i * l + j + 1) <= T, i.e. the blocks of pass j that
+// lie inside the segment.
+inline uint64_t NumBlocksInPass(uint64_t j, uint64_t k, uint64_t l, uint64_t T) {
+    uint64_t blocks = T / k;
+    return blocks > j ? (blocks - 1 - j) / l + 1 : 0;
+}
+
+const size_t kDefaultBCacheSize = 4096;
+
+// Thread-safe LRU of B values keyed by the SHA-256 of the serialized (x, y)
+// they were derived from. Only B values GetB derived itself are stored, so
+// a hit is the B a fresh HashPrime would give. An embedded B is never
+// taken on trust: showing it is the first prime of its hash chain takes
+// the same composite checks as deriving it.
+class BCache {
+  public:
+    explicit BCache(size_t capacity) : capacity(capacity) {}
+
+    bool Get(const std::string& key, integer& B) {
+        std::lock_guard<std::mutex> lk(mutex);
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+        lru.splice(lru.begin(), lru, it->second);
+        B = it->second->second;
+        return true;
+    }
+
+    void Put(const std::string& key, const integer& B) {
+        std::lock_guard<std::mutex> lk(mutex);
+        if (capacity == 0 || index.count(key))
+            return;
+        lru.emplace_front(key, B);
+        index[key] = lru.begin();
+        EvictLocked();
+    }
+
+    // A capacity of 0 disables caching.
+    void SetCapacity(size_t new_capacity) {
+        std::lock_guard<std::mutex> lk(mutex);
+        capacity = new_capacity;
+        EvictLocked();
+    }
+
+    size_t GetCapacity() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return capacity;
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return lru.size();
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lk(mutex);
+        index.clear();
+        lru.clear();
+    }
+
+  private:
+    typedef std::list<std::pair<std::string, integer>> lru_list;
+
+    std::mutex mutex;
+    size_t capacity;
+    lru_list lru;
+    std::unordered_map<std::string, lru_list::iterator> index;
+
+    void EvictLocked() {
+        while (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+};
+
+BCache& GetBCache()
+{
+    static BCache cache(kDefaultBCacheSize);
+    return cache;
+}
+
+// The prime B of the Wesolowski proof x -> y; repeated (x, y) are served
+// from GetBCache().
 integer GetB(const integer& D, form &x, form& y) {
     int d_bits = D.num_bits();
     std::vector<unsigned char> serialization = SerializeForm(x, d_bits);
     std::vector<unsigned char> serialization_y = SerializeForm(y, d_bits);
     serialization.insert(serialization.end(), serialization_y.begin(), serialization_y.end());
-    return HashPrime(serialization, B_bits, {B_bits - 1});
+
+    std::string key(picosha2::k_digest_size, '\0');
+    picosha2::hash256(serialization.begin(), serialization.end(), key.begin(), key.end());
+    integer B;
+    if (GetBCache().Get(key, B))
+        return B;
+    B = HashPrime(serialization, B_bits, {B_bits - 1});
+    GetBCache().Put(key, B);
+    return B;
+}
+
+// Whether B can be a GetB value at all: HashPrime sets bit B_bits - 1 and
+// bit 0 of a B_bits-bit candidate. A cheap reject for embedded B values
+// before any exponentiation; B == GetB(...) is still what decides.
+bool IsBWellFormed(const integer& B) {
+    return mpz_sgn(B.impl) > 0 && B.num_bits() == B_bits && mpz_odd_p(B.impl);
 }
 
 class PulmarkReducer {
@@ -97,20 +390,106 @@ class PulmarkReducer {
         delete(t);
     }
 
+    // Swaps the form's limbs into the context and back instead of copying,
+    // so the reduction works in place on f's own buffers.
     void reduce(form &f) {
-        mpz_set(t->a, f.a.impl);
-        mpz_set(t->b, f.b.impl);
-        mpz_set(t->c, f.c.impl);
+        mpz_swap(t->a, f.a.impl);
+        mpz_swap(t->b, f.b.impl);
+        mpz_swap(t->c, f.c.impl);
 
         reducer->run();
 
-        mpz_set(f.a.impl, t->a);
-        mpz_set(f.b.impl, t->b);
-        mpz_set(f.c.impl, t->c);
+        mpz_swap(f.a.impl, t->a);
+        mpz_swap(f.b.impl, t->b);
+        mpz_swap(f.c.impl, t->c);
     }
 };
 
-form FastPowFormNucomp(form x, integer &D, integer num_iterations, integer &L, PulmarkReducer& reducer)
+// Per-thread reducer for code that would otherwise construct a short-lived
+// PulmarkReducer (each one allocates a 4096-bit context). reduce() keeps no
+// state between calls, so nested users on the same thread may share it.
+PulmarkReducer& GetThreadPulmarkReducer()
+{
+    thread_local PulmarkReducer reducer;
+    return reducer;
+}
+
+// Window width for signed-digit exponentiation of an exponent with the given
+// bit length. A width-w table costs 2^(w-2) compositions and the recoded
+// exponent has about bits/(w+1) nonzero digits.
+inline int GetWNafWindow(int bits)
+{
+    if (bits <= 12) return 2;
+    if (bits <= 48) return 3;
+    if (bits <= 128) return 4;
+    if (bits <= 384) return 5;
+    return 6;
+}
+
+// Recodes a non-negative exponent into width-w NAF, least significant digit
+// first. Every nonzero digit is odd with |digit| < 2^(w-1), and any w
+// consecutive digits contain at most one nonzero digit.
+std::vector<int8_t> GetWNafDigits(const integer& e, int w)
+{
+    std::vector<int8_t> digits;
+    const long window = 1L << w, half = 1L << (w - 1);
+    integer k = e;
+    digits.reserve(k.num_bits() + 1);
+
+    while (mpz_sgn(k.impl) > 0) {
+        long d = 0;
+        if (mpz_odd_p(k.impl)) {
+            d = static_cast<long>(mpz_fdiv_ui(k.impl, window));
+            if (d >= half) {
+                d -= window;
+                mpz_add_ui(k.impl, k.impl, static_cast<unsigned long>(-d));
+            } else {
+                mpz_sub_ui(k.impl, k.impl, static_cast<unsigned long>(d));
+            }
+        }
+        digits.push_back(static_cast<int8_t>(d));
+        mpz_fdiv_q_2exp(k.impl, k.impl, 1);
+    }
+    return digits;
+}
+
+// Table of x, x^3, ..., x^(2^(w-1)-1) and their inverses for wNAF
+// exponentiation. Inverting (a, b, c) only negates b, so the negative
+// half of the table is free.
+struct WNafTable {
+    std::vector<form> pos;
+    std::vector<form> neg;
+
+    const form& get(int digit) const {
+        return digit > 0 ? pos[(digit - 1) / 2] : neg[(-digit - 1) / 2];
+    }
+};
+
+void PrecomputeWNafTable(const form& x, int w, integer &D, integer &L, PulmarkReducer& reducer, WNafTable& table)
+{
+    const size_t n = size_t(1) << (w - 2);
+    table.pos.resize(n);
+    table.neg.resize(n);
+    table.pos[0] = x;
+    if (n > 1) {
+        form x2 = x;
+        nudupl_form(x2, x2, D, L);
+        reducer.reduce(x2);
+        for (size_t i = 1; i < n; i++) {
+            nucomp_form(table.pos[i], table.pos[i - 1], x2, D, L);
+            reducer.reduce(table.pos[i]);
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        table.neg[i] = table.pos[i];
+        mpz_neg(table.neg[i].b.impl, table.neg[i].b.impl);
+    }
+}
+
+// Computes x^num_iterations. window == 1 selects plain left-to-right binary
+// square-and-multiply; window >= 2 uses a wNAF recoding of that width with a
+// table of odd powers.
+form FastPowFormNucompWindowed(form x, integer &D, integer num_iterations, integer &L, PulmarkReducer& reducer, int window)
 {
     if (!mpz_sgn(num_iterations.impl))
         return form::identity(D);
@@ -118,16 +497,111 @@ form FastPowFormNucomp(form x, integer &D, integer num_iterations, integer &L, P
     form res = x;
     int max_size = -D.impl->_mp_size / 2, i;
 
-    // Do exponentiation by squaring from top bits of exponent to bottom
-    for (i = num_iterations.num_bits() - 2; i >= 0; i--) {
+    if (window <= 1) {
+        // Do exponentiation by squaring from top bits of exponent to bottom
+        for (i = num_iterations.num_bits() - 2; i >= 0; i--) {
+            nudupl_form(res, res, D, L);
+            if (res.a.impl->_mp_size > max_size) {
+                // Reduce only when 'a' exceeds a half of the discriminant size
+                reducer.reduce(res);
+            }
+
+            if (num_iterations.get_bit(i)) {
+                nucomp_form(res, res, x, D, L);
+            }
+        }
+
+        reducer.reduce(res);
+        return res;
+    }
+
+    if (window > 7) {
+        throw std::invalid_argument("FastPowFormNucompWindowed: window too large");
+    }
+    WNafTable table;
+    PrecomputeWNafTable(x, window, D, L, reducer, table);
+    std::vector<int8_t> digits = GetWNafDigits(num_iterations, window);
+
+    // The top digit is always positive and nonzero.
+    i = static_cast<int>(digits.size()) - 1;
+    res = table.get(digits[i]);
+    for (i--; i >= 0; i--) {
         nudupl_form(res, res, D, L);
         if (res.a.impl->_mp_size > max_size) {
-            // Reduce only when 'a' exceeds a half of the discriminant size
             reducer.reduce(res);
         }
 
-        if (num_iterations.get_bit(i)) {
-            nucomp_form(res, res, x, D, L);
+        if (digits[i]) {
+            nucomp_form(res, res, table.get(digits[i]), D, L);
+            if (res.a.impl->_mp_size > max_size) {
+                reducer.reduce(res);
+            }
+        }
+    }
+
+    reducer.reduce(res);
+    return res;
+}
+
+form FastPowFormNucomp(form x, integer &D, integer num_iterations, integer &L, PulmarkReducer& reducer)
+{
+    int window = GetWNafWindow(num_iterations.num_bits());
+    return FastPowFormNucompWindowed(x, D, num_iterations, L, reducer, window);
+}
+
+// Computes prod(bases[i]^exponents[i]) with Straus' simultaneous
+// exponentiation over wNAF-recoded exponents: all exponents share one chain
+// of squarings, and each base contributes a multiplication only for its
+// nonzero digits.
+form FastMultiPowFormNucomp(const std::vector<form>& bases, const std::vector<integer>& exponents,
+                            integer &D, integer &L, PulmarkReducer& reducer)
+{
+    if (bases.size() != exponents.size()) {
+        throw std::invalid_argument("FastMultiPowFormNucomp: bases/exponents size mismatch");
+    }
+
+    std::vector<WNafTable> tables(bases.size());
+    std::vector<std::vector<int8_t>> digits(bases.size());
+    size_t max_digits = 0;
+    for (size_t j = 0; j < bases.size(); j++) {
+        if (mpz_sgn(exponents[j].impl) < 0) {
+            throw std::invalid_argument("FastMultiPowFormNucomp: negative exponent");
+        }
+        if (mpz_sgn(exponents[j].impl) == 0)
+            continue;
+        int window = GetWNafWindow(exponents[j].num_bits());
+        PrecomputeWNafTable(bases[j], window, D, L, reducer, tables[j]);
+        digits[j] = GetWNafDigits(exponents[j], window);
+        max_digits = std::max(max_digits, digits[j].size());
+    }
+    if (max_digits == 0)
+        return form::identity(D);
+
+    form res;
+    bool is_identity = true;
+    int max_size = -D.impl->_mp_size / 2;
+
+    for (size_t i = max_digits; i-- > 0;) {
+        if (!is_identity) {
+            nudupl_form(res, res, D, L);
+            if (res.a.impl->_mp_size > max_size) {
+                reducer.reduce(res);
+            }
+        }
+
+        for (size_t j = 0; j < bases.size(); j++) {
+            if (i >= digits[j].size() || !digits[j][i])
+                continue;
+            const form& f = tables[j].get(digits[j][i]);
+            if (is_identity) {
+                res = f;
+                is_identity = false;
+                continue;
+            }
+            nucomp_form(res, res, f, D, L);
+            if (res.a.impl->_mp_size > max_size) {
+                reducer.reduce(res);
+            }
         }
     }
 
@@ -0,0 +1,218 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+#include "prover.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class StoredFormsProver : public Prover {
+  public:
+    StoredFormsProver(Segment segm, integer D, const std::vector<form>& intermediates,
+                      uint32_t k, uint32_t l, uint64_t max_steps = UINT64_MAX)
+        : Prover(segm, D), intermediates(intermediates), max_steps(max_steps) {
+        this->k = k;
+        this->l = l;
+    }
+
+    form GetForm(uint64_t iteration) { return intermediates[iteration]; }
+    void start() { GenerateProof(); }
+    void stop() {}
+    bool PerformExtraStep() { return steps.fetch_add(1) < max_steps; }
+    void OnFinish() { NotifyFinished(); }
+    void AllowSteps(uint64_t n) {
+        steps = 0;
+        max_steps = n;
+    }
+
+  private:
+    const std::vector<form>& intermediates;
+    std::atomic<uint64_t> steps{0};
+    std::atomic<uint64_t> max_steps;
+};
+
+class StoredFormsParallelProver : public ParallelProver {
+  public:
+    StoredFormsParallelProver(Segment segm, integer D, const std::vector<form>& intermediates,
+                              uint32_t k, uint32_t l)
+        : ParallelProver(segm, D), intermediates(intermediates) {
+        this->k = k;
+        this->l = l;
+    }
+
+    form GetForm(uint64_t iteration) { return intermediates[iteration]; }
+    void start() { GenerateProof(); }
+    void stop() {}
+    bool PerformExtraStep() { return true; }
+    void OnFinish() { is_finished = true; }
+
+  private:
+    const std::vector<form>& intermediates;
+};
+
+}  // namespace
+
+// Squares once for the whole suite; each test takes the intermediates of
+// its k and l from the stored forms.
+class ProverBucketRegressionTest : public ::testing::Test {
+  protected:
+    static void SetUpTestSuite() {
+        std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+        d = CreateDiscriminant(challenge_hash, 1024);
+        integer L = root(-d, 4);
+        PulmarkReducer reducer;
+        form y = form::generator(d);
+        forms.reserve(iters + 1);
+        for (uint64_t i = 0; i < iters; i++) {
+            forms.push_back(y);
+            nudupl_form(y, y, d, L);
+            reducer.reduce(y);
+        }
+        forms.push_back(y);
+    }
+
+    static void TearDownTestSuite() {
+        forms.clear();
+    }
+
+    static std::vector<form> GetIntermediates(uint32_t k, uint32_t l) {
+        std::vector<form> intermediates;
+        for (uint64_t i = 0; i < iters; i += k * l)
+            intermediates.push_back(forms[i]);
+        return intermediates;
+    }
+
+    static constexpr uint64_t iters = 40000;
+    static integer d;
+    // forms[i] is the form after i squarings.
+    static std::vector<form> forms;
+};
+
+integer ProverBucketRegressionTest::d;
+std::vector<form> ProverBucketRegressionTest::forms;
+
+TEST_F(ProverBucketRegressionTest, BucketThreadsProduceIdenticalValidProof) {
+    const uint32_t k = 6, l = 2;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+
+    StoredFormsProver serial(sg, d, intermediates, k, l);
+    serial.start();
+    ASSERT_TRUE(serial.IsFinished());
+    form expected = serial.GetProof();
+
+    bool is_valid = false;
+    VerifyWesolowskiProof(d, forms[0], forms[iters], expected, iters, is_valid);
+    EXPECT_TRUE(is_valid);
+
+    for (uint32_t threads : {2u, 4u, 7u, 64u}) {
+        StoredFormsProver prover(sg, d, intermediates, k, l);
+        prover.SetBucketThreads(threads);
+        EXPECT_EQ(prover.GetBucketThreads(), threads);
+        prover.start();
+        ASSERT_TRUE(prover.IsFinished());
+        EXPECT_EQ(prover.GetProof(), expected) << "threads=" << threads;
+    }
+}
+
+TEST_F(ProverBucketRegressionTest, BucketThreadsStopWhenExtraStepFails) {
+    const uint32_t k = 6, l = 2;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+
+    StoredFormsProver prover(sg, d, intermediates, k, l, 1000);
+    prover.SetBucketThreads(4);
+    prover.start();
+    EXPECT_FALSE(prover.IsFinished());
+}
+
+TEST_F(ProverBucketRegressionTest, ParallelProverSplitsPassesAcrossThreads) {
+    const uint32_t k = 4, l = 7;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+
+    StoredFormsProver serial(sg, d, intermediates, k, l);
+    serial.start();
+    ASSERT_TRUE(serial.IsFinished());
+    form expected = serial.GetProof();
+
+    for (uint32_t threads : {1u, 2u, 3u, 7u, 16u}) {
+        StoredFormsParallelProver prover(sg, d, intermediates, k, l);
+        prover.SetThreads(threads);
+        EXPECT_EQ(prover.GetThreads(), threads);
+        prover.start();
+        ASSERT_TRUE(prover.IsFinished());
+        EXPECT_EQ(prover.GetProof(), expected) << "threads=" << threads;
+    }
+}
+
+TEST_F(ProverBucketRegressionTest, WaitForFinishReturnsOnCompletionOrStop) {
+    const uint32_t k = 6, l = 2;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+    std::atomic<bool> stop{false};
+
+    StoredFormsProver prover(sg, d, intermediates, k, l);
+    std::thread worker([&prover]() { prover.start(); });
+    EXPECT_TRUE(prover.WaitForFinish(stop));
+    worker.join();
+
+    StoredFormsProver interrupted(sg, d, intermediates, k, l, 1000);
+    interrupted.start();
+    stop = true;
+    EXPECT_FALSE(interrupted.WaitForFinish(stop));
+}
+
+TEST_F(ProverBucketRegressionTest, InterruptedProofContinuesWhereItStopped) {
+    const uint32_t k = 4, l = 3;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+
+    StoredFormsProver serial(sg, d, intermediates, k, l);
+    serial.start();
+    ASSERT_TRUE(serial.IsFinished());
+    form expected = serial.GetProof();
+
+    // Stops in every stage of every pass along the way.
+    for (uint32_t threads : {1u, 2u}) {
+        StoredFormsProver prover(sg, d, intermediates, k, l, 0);
+        prover.SetBucketThreads(threads);
+        int calls = 0;
+        for (uint64_t budget = 1; !prover.IsFinished(); budget = budget * 3 + 5) {
+            prover.AllowSteps(budget);
+            prover.start();
+            calls++;
+        }
+        EXPECT_GT(calls, 3);
+        EXPECT_EQ(prover.GetProof(), expected) << "threads=" << threads;
+    }
+}
+
+TEST_F(ProverBucketRegressionTest, BucketThreadsResumeSlicesOfAnInterruptedPass) {
+    const uint32_t k = 4, l = 3;
+    std::vector<form> intermediates = GetIntermediates(k, l);
+    Segment sg(0, iters, forms[0], forms[iters]);
+
+    StoredFormsProver serial(sg, d, intermediates, k, l);
+    serial.start();
+    ASSERT_TRUE(serial.IsFinished());
+    form expected = serial.GetProof();
+
+    // Every call is stopped well before a pass ends, the way a pool pauses a
+    // prover whenever a better segment arrives.
+    StoredFormsProver prover(sg, d, intermediates, k, l, 0);
+    prover.SetBucketThreads(4);
+    int calls = 0;
+    while (!prover.IsFinished() && calls < 10000) {
+        prover.AllowSteps(300);
+        prover.start();
+        calls++;
+    }
+    ASSERT_TRUE(prover.IsFinished());
+    EXPECT_EQ(prover.GetProof(), expected);
+}
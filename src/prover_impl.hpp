@@ -1,10 +1,15 @@
 #ifndef PROVER_IMPL_H
 #define PROVER_IMPL_H
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <stdexcept>
 #include <thread>
 
+#include "alloc.hpp"
+
 inline Prover::Prover(Segment segm, integer D) {
     this->segm = segm;
     this->D = D;
@@ -16,6 +21,22 @@ inline bool Prover::IsFinished() {
     return is_finished;
 }
 
+inline bool Prover::WaitForFinish(const std::atomic<bool>& stop_signal) {
+    std::unique_lock<std::mutex> lk(finish_mutex);
+    while (!is_finished && !stop_signal) {
+        finish_cv.wait_for(lk, kStopSignalPollInterval);
+    }
+    return is_finished;
+}
+
+inline void Prover::NotifyFinished() {
+    {
+        std::lock_guard<std::mutex> lk(finish_mutex);
+        is_finished = true;
+    }
+    finish_cv.notify_all();
+}
+
 inline form Prover::GetProof() {
     return proof;
 }
@@ -28,10 +49,99 @@ inline uint64_t Prover::GetBlock(uint64_t i, uint64_t k, uint64_t T, integer& B)
     return res_vector.empty() ? 0 : res_vector[0];
 }
 
+// Below this many intermediates per thread, spawning bucket threads costs
+// more than it saves.
+const uint64_t kMinFormsPerBucketThread = 256;
+
+// Folds every intermediate whose block digit belongs to pass j into ys[digit].
+// With several bucket threads, each thread accumulates a contiguous slice of
+// the intermediates into private buckets, which are then merged into ys.
+// Returns false if PerformExtraStep() asked to stop.
+inline bool Prover::AccumulateBuckets(std::vector<form>& ys, int64_t j, integer& B, integer& L, const form& id,
+                                      BucketSlices* slices) {
+    BucketSlices local;
+    BucketSlices& s = (slices != nullptr) ? *slices : local;
+    if (s.next.empty()) {
+        // Intermediates past the end of the segment have no digit in this pass.
+        uint64_t limit = NumBlocksInPass(j, k, l, num_iterations);
+        uint64_t n_slices = std::max<uint64_t>(1, std::min<uint64_t>(bucket_threads, limit / kMinFormsPerBucketThread));
+        uint64_t chunk = limit / n_slices;
+        for (uint64_t t = 0; t < n_slices; t++) {
+            s.next.push_back(t * chunk);
+            s.end.push_back((t + 1 == n_slices) ? limit : (t + 1) * chunk);
+        }
+        s.buckets.assign(n_slices - 1, std::vector<form>(1UL << k, id));
+    }
+
+    std::atomic<bool> stop{false};
+    // Folds slice t up to its end or until asked to stop, keeping its position.
+    auto accumulate = [&](uint64_t t) {
+        std::vector<form>& buckets = (t == 0) ? ys : s.buckets[t - 1];
+        uint64_t& i = s.next[t];
+        if (i >= s.end[t])
+            return;
+        // One modular exponentiation per slice, then cheap steps.
+        BlockDigitStream digits(i * l + j, l, k, num_iterations, B);
+        for (; i < s.end[t]; i++) {
+            if (stop.load(std::memory_order_relaxed))
+                return;
+            uint64_t b = digits.Next();
+            if (b >= (1UL << k)) {
+                throw std::runtime_error("GenerateProof block index out of bounds");
+            }
+            if (!PerformExtraStep()) {
+                stop = true;
+                return;
+            }
+            form tmp = GetForm(i);
+            nucomp_form(buckets[b], buckets[b], tmp, D, L);
+        }
+    };
+
+    uint64_t n_slices = s.next.size();
+    std::vector<std::exception_ptr> errors(n_slices);
+    std::vector<std::thread> workers;
+    for (uint64_t t = 1; t < n_slices; t++) {
+        if (s.next[t] >= s.end[t])
+            continue;
+        workers.emplace_back([&, t]() {
+            try {
+                accumulate(t);
+            } catch (...) {
+                errors[t] = std::current_exception();
+                stop = true;
+            }
+        });
+    }
+    try {
+        accumulate(0);
+    } catch (...) {
+        errors[0] = std::current_exception();
+        stop = true;
+    }
+    for (auto& worker : workers)
+        worker.join();
+    for (auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    if (stop)
+        return false;
+
+    for (auto& buckets : s.buckets) {
+        for (uint64_t b = 0; b < (1UL << k); b++) {
+            nucomp_form(ys[b], ys[b], buckets[b], D, L);
+        }
+    }
+    s = BucketSlices();
+    return true;
+}
+
 inline void Prover::GenerateProof() {
-    PulmarkReducer reducer;
+    PulmarkReducer& reducer = GetThreadPulmarkReducer();
+    // Buckets and temporaries live in an arena that is dropped in one go.
+    ScopedMpArena arena;
 
-    integer B = GetB(D, segm.x, segm.y);
     integer L = root(-D, 4);
     form id;
     try {
@@ -47,61 +157,76 @@ inline void Prover::GenerateProof() {
     }
     uint64_t k1 = k / 2;
     uint64_t k0 = k - k1;
-    form x = id;
 
-    for (int64_t j = l - 1; j >= 0; j--) {
-        x = FastPowFormNucomp(x, D, integer(1 << k), L, reducer);
+    // Continue where an interrupted call stopped, if it did.
+    std::unique_ptr<ProofProgress> p = std::move(progress);
+    if (p == nullptr) {
+        p.reset(new ProofProgress());
+        p->B = GetB(D, segm.x, segm.y);
+        p->x = id;
+        p->ys.resize(1 << k);
+        p->j = l - 1;
+        p->stage = ProofProgress::kStartPass;
+        p->next = 0;
+    }
+    // Keeps the progress for the next call, out of the arena.
+    auto suspend = [&]() {
+        if (arena.IsActive()) {
+            arena.Release();
+            progress.reset(new ProofProgress(*p));
+        } else {
+            progress = std::move(p);
+        }
+    };
 
-        std::vector<form> ys((1 << k));
-        for (uint64_t i = 0; i < (1UL << k); i++)
-            ys[i] = id;
+    for (; p->j >= 0; p->j--, p->stage = ProofProgress::kStartPass) {
+        if (p->stage == ProofProgress::kStartPass) {
+            p->x = FastPowFormNucomp(p->x, D, integer(1 << k), L, reducer);
+            for (uint64_t i = 0; i < (1UL << k); i++)
+                p->ys[i] = id;
+            p->stage = ProofProgress::kAccumulate;
+        }
 
-        uint64_t limit = num_iterations / (k * l);
-        if (num_iterations % (k * l))
-            limit++;
-        for (uint64_t i = 0; i < limit; i++) {
-            if (num_iterations >= k * (i * l + j + 1)) {
-                uint64_t b = GetBlock(i * l + j, k, num_iterations, B);
-                if (b >= (1UL << k)) {
-                    throw std::runtime_error("GenerateProof block index out of bounds");
-                }
-                if (!PerformExtraStep()) return;
-                form tmp = GetForm(i);
-                nucomp_form(ys[b], ys[b], tmp, D, L);
-            }
+        if (p->stage == ProofProgress::kAccumulate) {
+            if (!AccumulateBuckets(p->ys, p->j, p->B, L, id, &p->slices)) return suspend();
+            p->stage = ProofProgress::kFoldHigh;
+            p->next = 0;
         }
 
-        for (uint64_t b1 = 0; b1 < (1UL << k1); b1++) {
-            form z = id;
-            for (uint64_t b0 = 0; b0 < (1UL << k0); b0++) {
-                if (!PerformExtraStep()) return;
-                nucomp_form(z, z, ys[b1 * (1 << k0) + b0], D, L);
+        if (p->stage == ProofProgress::kFoldHigh) {
+            for (; p->next < (1UL << k1); p->next++) {
+                uint64_t b1 = p->next;
+                form z = id;
+                for (uint64_t b0 = 0; b0 < (1UL << k0); b0++) {
+                    if (!PerformExtraStep()) return suspend();
+                    nucomp_form(z, z, p->ys[b1 * (1 << k0) + b0], D, L);
+                }
+                z = FastPowFormNucomp(z, D, integer(b1 * (1 << k0)), L, reducer);
+                nucomp_form(p->x, p->x, z, D, L);
             }
-            z = FastPowFormNucomp(z, D, integer(b1 * (1 << k0)), L, reducer);
-            nucomp_form(x, x, z, D, L);
+            p->stage = ProofProgress::kFoldLow;
+            p->next = 0;
         }
 
-        for (uint64_t b0 = 0; b0 < (1UL << k0); b0++) {
+        for (; p->next < (1UL << k0); p->next++) {
+            uint64_t b0 = p->next;
             form z = id;
             for (uint64_t b1 = 0; b1 < (1UL << k1); b1++) {
-                if (!PerformExtraStep()) return;
-                nucomp_form(z, z, ys[b1 * (1 << k0) + b0], D, L);
+                if (!PerformExtraStep()) return suspend();
+                nucomp_form(z, z, p->ys[b1 * (1 << k0) + b0], D, L);
             }
             z = FastPowFormNucomp(z, D, integer(b0), L, reducer);
-            nucomp_form(x, x, z, D, L);
+            nucomp_form(p->x, p->x, z, D, L);
         }
     }
-    reducer.reduce(x);
-    proof = x;
+    reducer.reduce(p->x);
+    arena.Release();
+    proof = p->x;
     OnFinish();
 }
 
 inline ParallelProver::ParallelProver(Segment segm, integer D) : Prover(segm, D) {}
 
-inline void ParallelProver::ProofThread(ParallelProver* prover, uint8_t thr_idx, uint32_t start, uint32_t len) {
-    prover->ProvePart(thr_idx, start, len);
-}
-
 inline void ParallelProver::SquareFormN(form& f, uint64_t cnt, PulmarkReducer& reducer)
 {
     for (uint64_t i = 0; i < cnt; i++) {
@@ -110,38 +235,31 @@ inline void ParallelProver::SquareFormN(form& f, uint64_t cnt, PulmarkReducer& r
     }
 }
 
-inline void ParallelProver::ProvePart(uint8_t thr_idx, uint32_t start, uint32_t len) {
-    PulmarkReducer reducer;
+// Computes the contribution of passes [start - len, start) and stores it,
+// already shifted into place, in x_vals[part_idx].
+inline bool ParallelProver::ProvePart(uint32_t part_idx, uint32_t start, uint32_t len) {
+    PulmarkReducer& reducer = GetThreadPulmarkReducer();
+    ScopedMpArena arena;
 
     uint64_t k1 = k / 2;
     uint64_t k0 = k - k1;
     form x = id;
     int64_t end = start - len;
     int64_t j;
+    std::vector<form> ys((1 << k));
 
     for (j = start - 1; j >= end; j--) {
         x = FastPowFormNucomp(x, D, integer(1 << k), L, reducer);
 
-        std::vector<form> ys((1 << k));
         for (uint64_t i = 0; i < (1UL << k); i++)
             ys[i] = id;
 
-        uint64_t limit = num_iterations / (k * l);
-        if (num_iterations % (k * l))
-            limit++;
-        for (uint64_t i = 0; i < limit; i++) {
-            if (num_iterations >= k * (i * l + j + 1)) {
-                uint64_t b = GetBlock(i * l + j, k, num_iterations, B);
-                if (!PerformExtraStep()) return;
-                form tmp = GetForm(i);
-                nucomp_form(ys[b], ys[b], tmp, D, L);
-            }
-        }
+        if (!AccumulateBuckets(ys, j, B, L, id)) return false;
 
         for (uint64_t b1 = 0; b1 < (1UL << k1); b1++) {
             form z = id;
             for (uint64_t b0 = 0; b0 < (1UL << k0); b0++) {
-                if (!PerformExtraStep()) return;
+                if (!PerformExtraStep()) return false;
                 nucomp_form(z, z, ys[b1 * (1 << k0) + b0], D, L);
             }
             z = FastPowFormNucomp(z, D, integer(b1 * (1 << k0)), L, reducer);
@@ -151,7 +269,7 @@ inline void ParallelProver::ProvePart(uint8_t thr_idx, uint32_t start, uint32_t
         for (uint64_t b0 = 0; b0 < (1UL << k0); b0++) {
             form z = id;
             for (uint64_t b1 = 0; b1 < (1UL << k1); b1++) {
-                if (!PerformExtraStep()) return;
+                if (!PerformExtraStep()) return false;
                 nucomp_form(z, z, ys[b1 * (1 << k0) + b0], D, L);
             }
             z = FastPowFormNucomp(z, D, integer(b0), L, reducer);
@@ -160,26 +278,78 @@ inline void ParallelProver::ProvePart(uint8_t thr_idx, uint32_t start, uint32_t
     }
 
     SquareFormN(x, end * k, reducer);
-    x_vals[thr_idx] = x;
+    arena.Release();
+    x_vals[part_idx] = x;
+    return true;
 }
 
+// Each thread that splits the l passes takes this many parts on average, so
+// a thread that finishes early can pick up work left by slower ones.
+const uint32_t kParallelProverPartsPerThread = 4;
+
 inline void ParallelProver::GenerateProof() {
-    PulmarkReducer reducer;
+    PulmarkReducer& reducer = GetThreadPulmarkReducer();
 
     this->B = GetB(D, segm.x, segm.y);
     this->L = root(-D, 4);
     this->id = form::identity(D);
 
-    uint32_t l0 = l / 2;
-    uint32_t l1 = l - l0;
-    std::thread proof_thr(ParallelProver::ProofThread, this, 0, l, l0);
-    ProvePart(1, l1, l1);
+    uint32_t lane_threads = std::max<uint32_t>(1, std::min<uint32_t>(n_threads, l));
+    if (n_threads > lane_threads)
+        bucket_threads = std::max<uint32_t>(bucket_threads, n_threads / lane_threads);
+
+    // Every part but the last one needs (passes below it) * k extra squarings
+    // to be shifted into place, so only over-split when there are threads to
+    // balance.
+    uint32_t n_parts = lane_threads == 1 ? 1 : std::min<uint32_t>(l, lane_threads * kParallelProverPartsPerThread);
+    x_vals.assign(n_parts, id);
 
-    proof_thr.join();
-    if (!PerformExtraStep()) {
+    // Part p covers passes [l - ends[p + 1], l - ends[p]), i.e. the parts with
+    // the most shifting left to do are handed out first.
+    std::vector<uint32_t> ends(n_parts + 1);
+    for (uint32_t p = 0; p <= n_parts; p++)
+        ends[p] = static_cast<uint32_t>(uint64_t(l) * p / n_parts);
+
+    std::atomic<uint32_t> next_part{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::exception_ptr> errors(lane_threads);
+    auto run_parts = [&](uint32_t thr_idx) {
+        try {
+            uint32_t p;
+            while (!failed && (p = next_part.fetch_add(1)) < n_parts) {
+                uint32_t start = l - ends[p];
+                if (!ProvePart(p, start, ends[p + 1] - ends[p]))
+                    failed = true;
+            }
+        } catch (...) {
+            errors[thr_idx] = std::current_exception();
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 1; t < lane_threads; t++)
+        workers.emplace_back(run_parts, t);
+    run_parts(0);
+    for (auto& worker : workers)
+        worker.join();
+    for (auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    if (failed || !PerformExtraStep()) {
         return;
     }
-    nucomp_form(proof, x_vals[0], x_vals[1], D, L);
+
+    // Pairwise tree reduction of the partial results.
+    for (uint32_t stride = 1; stride < n_parts; stride *= 2) {
+        for (uint32_t i = 0; i + stride < n_parts; i += 2 * stride) {
+            nucomp_form(x_vals[i], x_vals[i], x_vals[i + stride], D, L);
+            reducer.reduce(x_vals[i]);
+        }
+    }
+    proof = x_vals[0];
     reducer.reduce(proof);
     OnFinish();
 }
@@ -2,10 +2,19 @@
 #define PROVER_INTERFACE_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 class PulmarkReducer;
 
+// How often blocking waits recheck a stop flag that is set without a
+// notification.
+const std::chrono::milliseconds kStopSignalPollInterval(100);
+
 class Prover {
   public:
     Prover(Segment segm, integer D);
@@ -18,11 +27,54 @@ class Prover {
     virtual void OnFinish() = 0;
 
     bool IsFinished();
+    // Blocks until OnFinish has run or stop_signal is set; returns
+    // IsFinished().
+    bool WaitForFinish(const std::atomic<bool>& stop_signal);
     form GetProof();
     uint64_t GetBlock(uint64_t i, uint64_t k, uint64_t T, integer& B);
     void GenerateProof();
 
+    // Number of threads that accumulate the proof buckets; 1 keeps the work
+    // on the calling thread. GetForm and PerformExtraStep must be thread-safe
+    // when this is larger than 1.
+    void SetBucketThreads(uint32_t n) { bucket_threads = n ? n : 1; }
+    uint32_t GetBucketThreads() const { return bucket_threads; }
+
   protected:
+    // Sets is_finished and wakes WaitForFinish callers; OnFinish
+    // implementations should use it.
+    void NotifyFinished();
+    // A pass of AccumulateBuckets split into slices, one per bucket thread.
+    // Slice t folds intermediates [next[t], end[t]) into its own buckets,
+    // slice 0 straight into ys. An interrupted pass keeps every slice's
+    // position and buckets, so the next call continues each of them.
+    struct BucketSlices {
+        std::vector<uint64_t> next;
+        std::vector<uint64_t> end;
+        std::vector<std::vector<form>> buckets;
+    };
+    // With slices set, an interrupted pass is continued from it and, if
+    // stopped again, left in it for a later call; it is empty once the pass
+    // is done.
+    bool AccumulateBuckets(std::vector<form>& ys, int64_t j, integer& B, integer& L, const form& id,
+                           BucketSlices* slices = nullptr);
+
+    // Where GenerateProof stopped when PerformExtraStep() returned false. The
+    // next GenerateProof call continues from here instead of starting over.
+    struct ProofProgress {
+        enum Stage { kStartPass, kAccumulate, kFoldHigh, kFoldLow };
+        integer B;
+        form x;
+        std::vector<form> ys;
+        int64_t j;
+        Stage stage;
+        // Where each slice is (kAccumulate).
+        BucketSlices slices;
+        // Next outer digit (kFold*).
+        uint64_t next;
+    };
+    std::unique_ptr<ProofProgress> progress;
+
     Segment segm;
     integer D;
     form proof;
@@ -30,25 +82,35 @@ class Prover {
     uint32_t k;
     uint32_t l;
     std::atomic<bool> is_finished;
+    uint32_t bucket_threads = 1;
+    std::mutex finish_mutex;
+    std::condition_variable finish_cv;
 };
 
-#define PARALLEL_PROVER_N_THREADS 2
+// Threads used by a ParallelProver unless SetThreads() says otherwise.
+const uint32_t kParallelProverDefaultThreads = 2;
 
 class ParallelProver : public Prover {
   private:
-    static void ProofThread(ParallelProver* prover, uint8_t thr_idx, uint32_t start, uint32_t len);
     void SquareFormN(form& f, uint64_t cnt, PulmarkReducer& reducer);
-    void ProvePart(uint8_t thr_idx, uint32_t start, uint32_t len);
+    bool ProvePart(uint32_t part_idx, uint32_t start, uint32_t len);
 
   public:
     ParallelProver(Segment segm, integer D);
     void GenerateProof();
 
+    // Number of threads working on the proof. The l passes are split into
+    // parts that the threads pick up as they become free; threads beyond l
+    // are used for bucket accumulation inside each part.
+    void SetThreads(uint32_t n) { n_threads = n ? n : 1; }
+    uint32_t GetThreads() const { return n_threads; }
+
   protected:
     integer B;
     integer L;
     form id;
-    form x_vals[PARALLEL_PROVER_N_THREADS];
+    std::vector<form> x_vals;
+    uint32_t n_threads = kParallelProverDefaultThreads;
 };
 
 #endif // PROVER_INTERFACE_H
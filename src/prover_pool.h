@@ -0,0 +1,173 @@
+#ifndef PROVER_POOL_H
+#define PROVER_POOL_H
+
+#include "provers.h"
+#include "thread_affinity.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running segment provers, best segment first by
+// Segment::IsWorseThan. When every thread is busy and a better segment is
+// submitted, the worst running prover is asked to yield; it returns its
+// thread at the next step, keeps its progress and goes back in the queue.
+// Paused provers therefore hold no thread.
+//
+// The queue is shared rather than per-thread: there are only a few dozen
+// coarse tasks, and a global queue keeps the priority order exact. One pool
+// may serve several ProverManagers; each cancels its own provers with
+// Cancel() when it stops.
+class ProverPool {
+  public:
+    explicit ProverPool(int n_threads) {
+        SetThreads(n_threads);
+    }
+
+    ~ProverPool() {
+        Stop();
+    }
+
+    ProverPool(const ProverPool&) = delete;
+    ProverPool& operator=(const ProverPool&) = delete;
+
+    // Thread count for max_proving_threads provers: at most one per core,
+    // leaving one core to the VDF loop.
+    static int GetThreadCount(int max_proving_threads) {
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        if (cores > 1)
+            max_proving_threads = std::min(max_proving_threads, cores - 1);
+        return std::max(max_proving_threads, 1);
+    }
+
+    // Grows the pool to n threads; it never shrinks.
+    void SetThreads(int n) {
+        std::lock_guard<std::mutex> lk(mutex);
+        while (!stopping && static_cast<int>(workers.size()) < n) {
+            workers.emplace_back([this] { WorkerLoop(); });
+        }
+    }
+
+    int GetThreads() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return static_cast<int>(workers.size());
+    }
+
+    // The prover must stay alive until it reports IsFullyFinished().
+    void Submit(InterruptableProver* prover) {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            if (stopping)
+                return;
+            queue.push_back(prover);
+            if (running.size() >= workers.size()) {
+                InterruptableProver* worst = nullptr;
+                for (InterruptableProver* p : running) {
+                    if (p->IsYieldRequested())
+                        continue;
+                    if (worst == nullptr || Worse(p, worst))
+                        worst = p;
+                }
+                if (worst != nullptr && Worse(worst, prover))
+                    worst->pause();
+            }
+        }
+        cv.notify_one();
+    }
+
+    // Drops the given provers from the queue and waits until the pool no
+    // longer uses any of them, so the caller can destroy them. Provers
+    // should be stopped first so that running ones return promptly.
+    void Cancel(const std::vector<InterruptableProver*>& provers) {
+        std::unique_lock<std::mutex> lk(mutex);
+        auto cancelled = [&](InterruptableProver* p) {
+            return std::find(provers.begin(), provers.end(), p) != provers.end();
+        };
+        queue.erase(std::remove_if(queue.begin(), queue.end(), cancelled), queue.end());
+        released_cv.wait(lk, [&] {
+            return std::none_of(running.begin(), running.end(), cancelled) &&
+                   std::none_of(releasing.begin(), releasing.end(), cancelled);
+        });
+    }
+
+    // Waits for running provers to return; queued ones are dropped. Provers
+    // should be stopped first so that they return promptly.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        cv.notify_all();
+        for (std::thread& worker : workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+    }
+
+  private:
+    static bool Worse(InterruptableProver* a, InterruptableProver* b) {
+        Segment sa = a->GetSegment();
+        Segment sb = b->GetSegment();
+        return sa.IsWorseThan(sb);
+    }
+
+    void WorkerLoop() {
+        PinWorkerThread();
+        while (true) {
+            InterruptableProver* prover;
+            {
+                std::unique_lock<std::mutex> lk(mutex);
+                cv.wait(lk, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    return;
+                auto best = queue.begin();
+                for (auto it = queue.begin(); it != queue.end(); ++it) {
+                    if (Worse(*best, *it))
+                        best = it;
+                }
+                prover = *best;
+                queue.erase(best);
+                prover->resume();
+                running.push_back(prover);
+            }
+
+            prover->start();
+
+            bool finished = prover->IsFinished();
+            {
+                std::lock_guard<std::mutex> lk(mutex);
+                running.erase(std::find(running.begin(), running.end(), prover));
+                if (finished)
+                    releasing.push_back(prover);
+                else if (!stopping)
+                    queue.push_back(prover);
+            }
+            released_cv.notify_all();
+            if (finished) {
+                prover->OnReleased();
+                {
+                    std::lock_guard<std::mutex> lk(mutex);
+                    releasing.erase(std::find(releasing.begin(), releasing.end(), prover));
+                }
+                // The owner may destroy the prover from here on.
+                released_cv.notify_all();
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::thread> workers;
+    // Provers waiting for a thread, new or yielded.
+    std::vector<InterruptableProver*> queue;
+    std::vector<InterruptableProver*> running;
+    // Finished provers whose owner is being notified.
+    std::vector<InterruptableProver*> releasing;
+    std::condition_variable released_cv;
+    bool stopping = false;
+};
+
+#endif // PROVER_POOL_H
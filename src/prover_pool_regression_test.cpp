@@ -0,0 +1,135 @@
+#include "verifier.h"
+#include "create_discriminant.h"
+#include "vdf.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Squares through two 2^16 segments once for the whole suite, storing their
+// intermediates the way the VDF loop does.
+class ProverPoolRegressionTest : public ::testing::Test {
+  protected:
+    static void SetUpTestSuite() {
+        std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+        d = CreateDiscriminant(challenge_hash, 1024);
+        form y = form::generator(d);
+        integer L = root(-d, 4);
+        weso = new FastAlgorithmCallback(1, d, y, false);
+        PulmarkReducer reducer;
+        for (uint64_t i = 0; i < (2 << 16); i++) {
+            nudupl_form(y, y, d, L);
+            reducer.reduce(y);
+            weso->OnIteration(NL_FORM, &y, i);
+        }
+        for (uint64_t i = 0; i < 2; i++) {
+            segments.emplace_back(i << 16, 1 << 16, weso->checkpoints[i], weso->checkpoints[i + 1]);
+        }
+    }
+
+    static void TearDownTestSuite() {
+        segments.clear();
+        delete weso;
+        weso = nullptr;
+    }
+
+    static integer d;
+    static FastAlgorithmCallback* weso;
+    static std::vector<Segment> segments;
+};
+
+integer ProverPoolRegressionTest::d;
+FastAlgorithmCallback* ProverPoolRegressionTest::weso = nullptr;
+std::vector<Segment> ProverPoolRegressionTest::segments;
+
+TEST_F(ProverPoolRegressionTest, RunsBestSegmentsAndYieldsForBetterOnes) {
+    std::atomic<bool> never(false);
+
+    std::vector<std::unique_ptr<InterruptableProver>> provers;
+    for (const Segment& sg : segments)
+        provers.emplace_back(new InterruptableProver(sg, d, weso));
+    {
+        ProverPool pool(1);
+        EXPECT_EQ(pool.GetThreads(), 1);
+        // The worse segment first; the better one then preempts it.
+        pool.Submit(provers[1].get());
+        while (!provers[1]->HasStarted())
+            std::this_thread::yield();
+        pool.Submit(provers[0].get());
+        for (auto& prover : provers)
+            prover->WaitForFinish(never);
+        for (auto& prover : provers) {
+            while (!prover->IsFullyFinished())
+                std::this_thread::yield();
+        }
+    }
+
+    for (size_t i = 0; i < provers.size(); i++) {
+        ASSERT_TRUE(provers[i]->IsFinished());
+        form proof = provers[i]->GetProof();
+        bool is_valid = false;
+        VerifyWesolowskiProof(d, segments[i].x, segments[i].y, proof, segments[i].length, is_valid);
+        EXPECT_TRUE(is_valid) << "segment " << i;
+    }
+}
+
+TEST_F(ProverPoolRegressionTest, StopReturnsWithUnfinishedProvers) {
+    std::vector<std::unique_ptr<InterruptableProver>> provers;
+    for (const Segment& sg : segments)
+        provers.emplace_back(new InterruptableProver(sg, d, weso));
+
+    ProverPool pool(2);
+    for (auto& prover : provers)
+        pool.Submit(prover.get());
+    for (auto& prover : provers)
+        prover->stop();
+    pool.Stop();
+    // Later submissions are ignored.
+    pool.Submit(provers[0].get());
+    EXPECT_EQ(pool.GetThreads(), 2);
+}
+
+TEST_F(ProverPoolRegressionTest, CancelReleasesOnlyTheGivenProvers) {
+    std::atomic<bool> never(false);
+    auto cancelled = std::make_unique<InterruptableProver>(segments[1], d, weso);
+    auto kept = std::make_unique<InterruptableProver>(segments[0], d, weso);
+
+    // A pool shared by two owners; one of them stops.
+    ProverPool pool(1);
+    pool.Submit(cancelled.get());
+    while (!cancelled->HasStarted())
+        std::this_thread::yield();
+    pool.Submit(kept.get());
+    cancelled->stop();
+    pool.Cancel({cancelled.get()});
+    cancelled.reset();
+
+    kept->WaitForFinish(never);
+    while (!kept->IsFullyFinished())
+        std::this_thread::yield();
+    bool is_valid = false;
+    VerifyWesolowskiProof(d, segments[0].x, segments[0].y, kept->GetProof(), segments[0].length, is_valid);
+    EXPECT_TRUE(is_valid);
+}
+
+TEST_F(ProverPoolRegressionTest, OwnerMayDestroyProverOnceFullyFinished) {
+    ProverPool pool(1);
+    for (int round = 0; round < 4; round++) {
+        InterruptableProver* prover = new InterruptableProver(segments[0], d, weso);
+        // The event loop erases a prover as soon as the flag flips, while
+        // the pool thread may still be releasing it.
+        std::thread owner([prover] {
+            while (!prover->IsFullyFinished())
+                std::this_thread::yield();
+            delete prover;
+        });
+        pool.Submit(prover);
+        owner.join();
+        // The release is still reported to the owner's event loop.
+        weso->WaitForEvent();
+    }
+}
@@ -1,3 +1,6 @@
+#ifndef PROVER_SLOW_H
+#define PROVER_SLOW_H
+
 #include "include.h"
 #include "create_discriminant.h"
 #include "integer_common.h"
@@ -6,8 +9,11 @@
 #include "picosha2.h"
 #include "proof_common.h"
 #include "checked_cast.h"
+#include "alloc.hpp"
+#include "prover.hpp"
 #include <sys/stat.h>
 #include <limits>
+#include <thread>
 
 
 // TODO: Refactor to use 'Prover' class once new_vdf is merged in.
@@ -54,6 +60,8 @@ form GenerateWesolowski(form &y, form &x_init,
                         std::vector<form> const& intermediates,
                         uint64_t num_iterations,
                         uint64_t k, uint64_t l) {
+    // Buckets and temporaries live in an arena that is dropped in one go.
+    ScopedMpArena arena;
     integer B = GetB(D, x_init, y);
     integer L=root(-D, 4);
 
@@ -62,18 +70,21 @@ form GenerateWesolowski(form &y, form &x_init,
     assert(k > 0);
     assert(l > 0);
 
-    form x = form::identity(D);
+    form id = form::identity(D);
+    form x = id;
+    std::vector<form> ys((1ULL << k));
 
     for (int64_t j = l - 1; j >= 0; j--) {
         x = FastPowFormNucomp(x, D, integer(1 << k), L, reducer);
 
-        std::vector<form> ys((1ULL << k));
         for (uint64_t i = 0; i < (1ULL << k); i++)
-            ys[i] = form::identity(D);
+            ys[i] = id;
 
-        for (uint64_t i = 0; i < (num_iterations + k * l - 1)  / (k * l); i++) {
-            if (num_iterations >= k * (i * l + j + 1)) {
-                uint64_t b = GetBlock(i*l + j, k, num_iterations, B);
+        uint64_t in_range = NumBlocksInPass(j, k, l, num_iterations);
+        if (in_range > 0) {
+            BlockDigitStream digits(j, l, k, num_iterations, B);
+            for (uint64_t i = 0; i < in_range; i++) {
+                uint64_t b = digits.Next();
                 nucomp_form(ys[b], ys[b], intermediates[i], D, L);
             }
         }
@@ -97,12 +108,54 @@ form GenerateWesolowski(form &y, form &x_init,
     }
 
     reducer.reduce(x);
-    return x;
+    arena.Release();
+    form result = x;
+    return result;
 }
 
-std::vector<uint8_t> ProveSlow(integer& D, form& x, uint64_t num_iterations, std::string shutdown_file_path) {
+// Proves from the intermediates stored by ProveSlow on several threads.
+class SlowParallelProver : public ParallelProver {
+  public:
+    SlowParallelProver(Segment segm, integer D, std::vector<form> const& intermediates, int k, int l)
+        : ParallelProver(segm, D), intermediates(intermediates)
+    {
+        this->k = k;
+        this->l = l;
+    }
+
+    form GetForm(uint64_t iteration) {
+        return intermediates[iteration];
+    }
+
+    void start() {
+        GenerateProof();
+    }
+
+    void stop() {
+    }
+
+    bool PerformExtraStep() {
+        return true;
+    }
+
+    void OnFinish() {
+        NotifyFinished();
+    }
+
+  private:
+    std::vector<form> const& intermediates;
+};
+
+// num_threads == 1 generates the proof on the calling thread, 0 uses every
+// hardware thread.
+// Proof generation cannot overlap with the squaring: every bucket digit comes
+// from B = HashPrime(x, y), so nothing can be accumulated before the last
+// squaring has produced y. Generating the proof on several threads is what
+// shortens the tail.
+std::vector<uint8_t> ProveSlow(integer& D, form& x, uint64_t num_iterations, std::string shutdown_file_path,
+                               uint32_t num_threads = 1) {
     integer L = root(-D, 4);
-    PulmarkReducer reducer;
+    PulmarkReducer& reducer = GetThreadPulmarkReducer();
     form y = form::from_abd(x.a, x.b, D);
     int d_bits = D.num_bits();
 
@@ -138,9 +191,22 @@ std::vector<uint8_t> ProveSlow(integer& D, form& x, uint64_t num_iterations, std
         }
     }
 
-    form proof = GenerateWesolowski(y, x, D, reducer, intermediates, num_iterations, k, l);
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    form proof;
+    if (num_threads == 1) {
+        proof = GenerateWesolowski(y, x, D, reducer, intermediates, num_iterations, k, l);
+    } else {
+        Segment sg(0, num_iterations, x, y);
+        SlowParallelProver prover(sg, D, intermediates, k, l);
+        prover.SetThreads(num_threads);
+        prover.start();
+        proof = prover.GetProof();
+    }
     std::vector<uint8_t> result = SerializeForm(y, d_bits);
     std::vector<uint8_t> proof_bytes = SerializeForm(proof, d_bits);
     result.insert(result.end(), proof_bytes.begin(), proof_bytes.end());
     return result;
 }
+
+#endif // PROVER_SLOW_H
@@ -31,3 +31,39 @@ TEST(ProverSlowRegressionTest, ProveSlowHandlesTinyIterationsThatTriggerKZeroEst
         EXPECT_NO_THROW((void)DeserializeForm(d, proof_blob.data() + BQFC_FORM_SIZE, BQFC_FORM_SIZE));
     }
 }
+
+TEST(ProverSlowRegressionTest, ProveSlowThreadCountDoesNotChangeProof) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form x = form::generator(d);
+
+    std::vector<uint8_t> expected = ProveSlow(d, x, 30000, "");
+    for (uint32_t threads : {0u, 2u, 5u}) {
+        EXPECT_EQ(ProveSlow(d, x, 30000, "", threads), expected) << "threads=" << threads;
+    }
+}
+
+TEST(ProverSlowRegressionTest, BlockDigitStreamMatchesGetBlock) {
+    integer B = HashPrime({1, 2, 3, 4}, B_bits, {B_bits - 1});
+    struct Params {
+        uint64_t k, l, T;
+    };
+    for (const Params& p : {Params{1, 1, 300}, Params{10, 1, 100000}, Params{12, 10, 1000003}, Params{7, 3, 999}}) {
+        for (uint64_t j = 0; j < p.l; j++) {
+            uint64_t count = NumBlocksInPass(j, p.k, p.l, p.T);
+            uint64_t expected_count = 0;
+            while (p.T >= p.k * (expected_count * p.l + j + 1))
+                expected_count++;
+            ASSERT_EQ(count, expected_count);
+            for (uint64_t first : {uint64_t(0), count / 2}) {
+                if (first >= count)
+                    continue;
+                BlockDigitStream digits(first * p.l + j, p.l, p.k, p.T, B);
+                for (uint64_t i = first; i < count; i++) {
+                    ASSERT_EQ(digits.Next(), GetBlock(i * p.l + j, p.k, p.T, B))
+                        << "k=" << p.k << " l=" << p.l << " j=" << j << " i=" << i;
+                }
+            }
+        }
+    }
+}
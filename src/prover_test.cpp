@@ -56,7 +56,6 @@ int main() {
     WesolowskiCallback* weso = new FastAlgorithmCallback(segments, D, f, multi_proc_machine);
     std::cout << "Discriminant: " << D.to_string() << "\n";
     std::atomic<bool> stopped = false;
-    fast_algorithm = true;
     FastStorage* fast_storage = NULL;
     if (multi_proc_machine) {
         fast_storage = new FastStorage((FastAlgorithmCallback*)weso);
@@ -34,7 +34,7 @@ class OneWesolowskiProver : public Prover {
     }
 
     void OnFinish() {
-        is_finished = true;
+        NotifyFinished();
     }
 
   private:
@@ -88,7 +88,7 @@ class TwoWesolowskiProver : public Prover{
     }
 
     void OnFinish() {
-        is_finished = true;
+        NotifyFinished();
     }
 
   private:
@@ -98,10 +98,9 @@ class TwoWesolowskiProver : public Prover{
     std::thread worker;
 };
 
-extern bool new_event;
-extern std::mutex new_event_mutex;
-extern std::condition_variable new_event_cv;
-
+// A segment proof run by ProverPool. start() works on the calling thread
+// until the proof is done or the prover is asked to yield; progress is kept,
+// so the next start() continues where it stopped.
 class InterruptableProver: public Prover {
   public:
     InterruptableProver(Segment segm, integer D, FastAlgorithmCallback* weso) : Prover(segm, D) {
@@ -116,66 +115,49 @@ class InterruptableProver: public Prover {
             l = 1;
         else
             l = (segm.length >> 18);
-        is_paused = false;
+        yield_requested = false;
+        started = false;
         is_fully_finished = false;
-        joined = false;
     }
 
-    ~InterruptableProver() {
-        if (!joined) {
-            th->join();
-        }
-        delete(th);
+    form GetForm(uint64_t i) {
+        return weso->GetForm(done_iterations + i * k * l, bucket);
     }
 
-    form GetForm(uint64_t i) {
-        return *weso->GetForm(done_iterations + i * k * l, bucket);
+    const Segment& GetSegment() const {
+        return segm;
     }
 
     void start() {
-        th = new std::thread([=] { GenerateProof(); });
+        started = true;
+        GenerateProof();
     }
 
+    bool HasStarted() {
+        return started;
+    }
+
+    // Abandons the proof. The pool running it returns it at the next step.
     void stop() {
-        {
-            std::lock_guard<std::mutex> lk(m);
-            is_finished = true;
-            is_fully_finished = true;
-            if (is_paused) {
-                is_paused = false;
-            }
-        }
-        cv.notify_one();
-        th->join();
-        joined = true;
+        is_finished = true;
+        is_fully_finished = true;
     }
 
     bool PerformExtraStep() {
-        if (is_finished) {
-            return false;
-        }
-        std::unique_lock<std::mutex> lk(m);
-        cv.wait(lk, [&] {
-            return !is_paused;
-        });
-        return true;
+        return !is_finished && !yield_requested;
     }
 
+    // Asks a running start() to return at the next step.
     void pause() {
-        std::lock_guard<std::mutex> lk(m);
-        is_paused = true;
+        yield_requested = true;
     }
 
     void resume() {
-        {
-            std::lock_guard<std::mutex> lk(m);
-            is_paused = false;
-        }
-        cv.notify_one();
+        yield_requested = false;
     }
 
-    bool IsRunning() {
-        return !is_paused;
+    bool IsYieldRequested() {
+        return yield_requested;
     }
 
     bool IsFullyFinished() {
@@ -183,26 +165,27 @@ class InterruptableProver: public Prover {
     }
 
     void OnFinish() {
-        is_finished = true;
+        NotifyFinished();
+    }
+
+    // Called by the pool once it no longer uses a finished prover, which can
+    // then be destroyed.
+    void OnReleased() {
         if (!is_fully_finished) {
-            // Notify event loop a proving thread is free.
-            {
-                std::lock_guard<std::mutex> lk(new_event_mutex);
-                new_event = true;
-            }
-            new_event_cv.notify_one();
+            // The event loop may destroy the prover as soon as the flag is
+            // set, so nothing of this may be touched after the store.
+            FastAlgorithmCallback* weso = this->weso;
             is_fully_finished = true;
+            // Notify event loop a proving thread is free.
+            weso->NotifyEvent();
         }
     }
 
   private:
-    std::thread* th;
     FastAlgorithmCallback* weso;
-    std::condition_variable cv;
-    std::mutex m;
-    bool is_paused;
+    std::atomic<bool> yield_requested;
+    std::atomic<bool> started;
     std::atomic<bool> is_fully_finished;
-    bool joined;
     uint64_t done_iterations;
     int bucket;
 };
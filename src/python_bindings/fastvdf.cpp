@@ -1,4 +1,5 @@
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
 #include "../verifier.h"
 #include "../prover_slow.h"
 #include "../alloc.hpp"
@@ -28,8 +29,11 @@ static py::bytes to_signed_bytes_be(const integer& value) {
 PYBIND11_MODULE(_chiavdf, m) {
     m.doc() = "Chia proof of time";
 
-    // Creates discriminant.
-    m.def("create_discriminant", [] (const py::bytes& challenge_hash, int discriminant_size_bits) {
+    // Creates discriminant, searching on num_threads threads (0 = all
+    // hardware threads, larger counts are capped to that, negative ones
+    // raise ValueError); the result doesn't depend on num_threads.
+    m.def("create_discriminant", [] (const py::bytes& challenge_hash, int discriminant_size_bits,
+                                     int num_threads) {
         std::string challenge_hash_str(challenge_hash);
         integer D;
         {
@@ -37,11 +41,12 @@ PYBIND11_MODULE(_chiavdf, m) {
             auto challenge_hash_bits = std::vector<uint8_t>(challenge_hash_str.begin(), challenge_hash_str.end());
             D = CreateDiscriminant(
                 challenge_hash_bits,
-                discriminant_size_bits
+                discriminant_size_bits,
+                num_threads
             );
         }
         return D.to_string();
-    });
+    }, py::arg("challenge_hash"), py::arg("discriminant_size_bits"), py::arg("num_threads") = 1);
 
     // Checks a simple wesolowski proof.
     m.def("verify_wesolowski", [] (const string& discriminant,
@@ -75,11 +80,57 @@ PYBIND11_MODULE(_chiavdf, m) {
         bool is_valid = false;
         {
             py::gil_scoped_release release;
-            is_valid=CheckProofOfTimeNWesolowski(integer(discriminant_copy), (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, disc_size_bits, recursion);
+            integer D(discriminant_copy);
+            is_valid=CheckProofOfTimeNWesolowski(D, (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, disc_size_bits, recursion);
         }
         return is_valid;
     });
 
+    // Checks an N wesolowski proof, spreading the independent exponentiations
+    // over num_threads threads (0 = all hardware threads).
+    m.def("verify_n_wesolowski_parallel", [] (const string& discriminant,
+                                   const string& x_s,
+                                   const string& proof_blob,
+                                   const uint64_t num_iterations, const uint64_t disc_size_bits, const uint64_t recursion,
+                                   int num_threads) {
+        std::string discriminant_copy(discriminant);
+        std::string x_s_copy(x_s);
+        std::string proof_blob_copy(proof_blob);
+        bool is_valid = false;
+        {
+            py::gil_scoped_release release;
+            integer D(discriminant_copy);
+            is_valid=CheckProofOfTimeNWesolowskiParallel(D, (const uint8_t *)x_s_copy.data(), (const uint8_t *)proof_blob_copy.data(), proof_blob_copy.size(), num_iterations, disc_size_bits, recursion, num_threads);
+        }
+        return is_valid;
+    }, py::arg("discriminant"), py::arg("x_s"), py::arg("proof_blob"), py::arg("num_iterations"),
+       py::arg("disc_size_bits"), py::arg("recursion"), py::arg("num_threads") = 0);
+
+    // Checks many N wesolowski proofs sharing one discriminant. Each item is a
+    // (x_s, proof_blob, num_iterations, recursion) tuple; returns one bool per item.
+    m.def("verify_n_wesolowski_batch", [] (const string& discriminant,
+                                   const std::vector<std::tuple<std::string, std::string, uint64_t, uint64_t>>& items,
+                                   const uint64_t disc_size_bits) {
+        std::string discriminant_copy(discriminant);
+        std::vector<NWesolowskiBatchItem> batch;
+        batch.reserve(items.size());
+        for (const auto& item : items) {
+            NWesolowskiBatchItem batch_item;
+            batch_item.x_s.assign(std::get<0>(item).begin(), std::get<0>(item).end());
+            batch_item.proof_blob.assign(std::get<1>(item).begin(), std::get<1>(item).end());
+            batch_item.iterations = std::get<2>(item);
+            batch_item.depth = std::get<3>(item);
+            batch.push_back(std::move(batch_item));
+        }
+        std::vector<bool> results;
+        {
+            py::gil_scoped_release release;
+            integer D(discriminant_copy);
+            results = CheckProofOfTimeNWesolowskiBatch(D, batch, disc_size_bits);
+        }
+        return results;
+    });
+
     // Checks an N wesolowski proof.
     m.def("create_discriminant_and_verify_n_wesolowski", [] (const py::bytes& challenge_hash,
                                    const int discriminant_size_bits,
@@ -99,7 +150,9 @@ PYBIND11_MODULE(_chiavdf, m) {
         return is_valid;
     });
 
-    m.def("prove", [] (const py::bytes& challenge_hash, const string& x_s, int discriminant_size_bits, uint64_t num_iterations, const string& shutdown_file_path) {
+    // num_threads == 0 uses every hardware thread for proof generation.
+    m.def("prove", [] (const py::bytes& challenge_hash, const string& x_s, int discriminant_size_bits, uint64_t num_iterations, const string& shutdown_file_path,
+                       uint32_t num_threads) {
         std::string challenge_hash_str(challenge_hash);
         std::string x_s_copy(x_s);
         std::vector<uint8_t> result;
@@ -112,11 +165,12 @@ PYBIND11_MODULE(_chiavdf, m) {
                     discriminant_size_bits
             );
             form x = DeserializeForm(D, (const uint8_t *) x_s_copy.data(), x_s_copy.size());
-            result = ProveSlow(D, x, num_iterations, shutdown_file_path_copy);
+            result = ProveSlow(D, x, num_iterations, shutdown_file_path_copy, num_threads);
         }
         py::bytes ret = py::bytes(reinterpret_cast<char*>(result.data()), result.size());
         return ret;
-    });
+    }, py::arg("challenge_hash"), py::arg("x_s"), py::arg("discriminant_size_bits"), py::arg("num_iterations"),
+       py::arg("shutdown_file_path"), py::arg("num_threads") = 1);
 
     // Checks an N wesolowski proof, given y is given by 'GetB()' instead of a form.
     m.def("verify_n_wesolowski_with_b", [] (const string& discriminant,
@@ -132,7 +186,8 @@ PYBIND11_MODULE(_chiavdf, m) {
         {
             py::gil_scoped_release release;
             uint8_t *proof_blob_ptr = reinterpret_cast<uint8_t *>(proof_blob_copy.data());
-            result = CheckProofOfTimeNWesolowskiWithB(integer(discriminant_copy), integer(B_copy), (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, recursion);
+            integer D(discriminant_copy);
+            result = CheckProofOfTimeNWesolowskiWithB(D, integer(B_copy), (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, recursion);
         }
         py::bytes res_bytes = py::bytes(reinterpret_cast<char*>(result.second.data()), result.second.size());
         return py::tuple(py::make_tuple(result.first, res_bytes));
@@ -163,8 +218,37 @@ PYBIND11_MODULE(_chiavdf, m) {
         {
             py::gil_scoped_release release;
             uint8_t *proof_blob_ptr = reinterpret_cast<uint8_t *>(proof_blob_copy.data());
-            B = GetBFromProof(integer(discriminant_copy), (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, recursion);
+            integer D(discriminant_copy);
+            B = GetBFromProof(D, (const uint8_t *)x_s_copy.data(), proof_blob_ptr, proof_blob_copy.size(), num_iterations, recursion);
         }
         return B.to_string();
     });
+
+    // Controls for the per-discriminant verification context cache used by
+    // the verify_* functions above.
+    m.def("set_verifier_cache_capacity", [] (size_t capacity) {
+        GetVerifierContextCache().SetCapacity(capacity);
+    }, py::arg("capacity"));
+
+    m.def("clear_verifier_cache", [] () {
+        GetVerifierContextCache().Clear();
+    });
+
+    m.def("verifier_cache_size", [] () {
+        return GetVerifierContextCache().Size();
+    });
+
+    // Controls for the cache of B values derived from (x, y), which makes
+    // repeated checks of the same segment skip HashPrime.
+    m.def("set_b_cache_capacity", [] (size_t capacity) {
+        GetBCache().SetCapacity(capacity);
+    }, py::arg("capacity"));
+
+    m.def("clear_b_cache", [] () {
+        GetBCache().Clear();
+    });
+
+    m.def("b_cache_size", [] () {
+        return GetBCache().Size();
+    });
 }
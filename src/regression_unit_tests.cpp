@@ -1,5 +1,20 @@
 #include "checked_cast_test.cpp"
+#include "checkpoint_store_regression_test.cpp"
+#include "compact_form_store_regression_test.cpp"
 #include "discriminant_bounds_regression_test.cpp"
+#include "fast_pow_regression_test.cpp"
+#include "fast_storage_regression_test.cpp"
+#include "hash_prime_regression_test.cpp"
+#include "mp_arena_regression_test.cpp"
+#include "primetest_regression_test.cpp"
 #include "proof_deserialization_regression_test.cpp"
+#include "prover_bucket_regression_test.cpp"
+#include "prover_pool_regression_test.cpp"
 #include "prover_slow_regression_test.cpp"
+#include "sha256_multibuffer_regression_test.cpp"
+#include "thread_affinity_regression_test.cpp"
+#include "threading_regression_test.cpp"
 #include "two_weso_callback_regression_test.cpp"
+#include "verifier_batch_regression_test.cpp"
+#include "verifier_context_regression_test.cpp"
+#include "verifier_parallel_regression_test.cpp"
@@ -0,0 +1,251 @@
+#ifndef SHA256_MULTIBUFFER_H
+#define SHA256_MULTIBUFFER_H
+
+#include "parameters.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(ARCH_X86) || defined(ARCH_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define SHA256_HAS_AVX2_LANES 1
+#include <immintrin.h>
+#define SHA256_AVX2 __attribute__((target("avx2")))
+#endif
+
+// SHA-256 of runs of messages that differ only in a big-endian counter at
+// their end, which is what HashPrime hashes. Every message of a run shares
+// the bytes before the highest counter byte that changes, so the blocks
+// made of those bytes are compressed once (the midstate) and only the
+// remaining blocks per message. With AVX2 the remaining blocks of eight
+// messages are compressed together, one message per 32-bit lane.
+
+enum class Sha256Backend {
+    kScalar,
+    kAvx2,
+};
+
+namespace sha256_multibuffer {
+
+const uint32_t kRoundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint32_t kInitialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const int kLanes = 8;
+
+inline uint32_t Rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+inline uint32_t LoadBigEndian(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline void StoreBigEndian(uint8_t* p, uint32_t x) {
+    p[0] = uint8_t(x >> 24);
+    p[1] = uint8_t(x >> 16);
+    p[2] = uint8_t(x >> 8);
+    p[3] = uint8_t(x);
+}
+
+inline void Compress(uint32_t state[8], const uint8_t* block) {
+    uint32_t w[64];
+    for (int t = 0; t < 16; t++)
+        w[t] = LoadBigEndian(block + 4 * t);
+    for (int t = 16; t < 64; t++) {
+        uint32_t s0 = Rotr(w[t - 15], 7) ^ Rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+        uint32_t s1 = Rotr(w[t - 2], 17) ^ Rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int t = 0; t < 64; t++) {
+        uint32_t t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + kRoundConstants[t] + w[t];
+        uint32_t t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+#if SHA256_HAS_AVX2_LANES
+SHA256_AVX2 inline __m256i Rotr8(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+// Compresses blocks[lane] into word i of lane `lane` of state[i], for all
+// eight lanes.
+SHA256_AVX2 inline void Compress8(uint32_t state[8][kLanes], const uint8_t* const blocks[kLanes]) {
+    __m256i w[64];
+    for (int t = 0; t < 16; t++) {
+        alignas(32) uint32_t words[kLanes];
+        for (int lane = 0; lane < kLanes; lane++)
+            words[lane] = LoadBigEndian(blocks[lane] + 4 * t);
+        w[t] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words));
+    }
+    for (int t = 16; t < 64; t++) {
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(w[t - 15], 7), Rotr8(w[t - 15], 18)),
+                                      _mm256_srli_epi32(w[t - 15], 3));
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(w[t - 2], 17), Rotr8(w[t - 2], 19)),
+                                      _mm256_srli_epi32(w[t - 2], 10));
+        w[t] = _mm256_add_epi32(_mm256_add_epi32(w[t - 16], s0), _mm256_add_epi32(w[t - 7], s1));
+    }
+    __m256i v[8];
+    for (int i = 0; i < 8; i++)
+        v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[i]));
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    for (int t = 0; t < 64; t++) {
+        __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(e, 6), Rotr8(e, 11)), Rotr8(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                                      _mm256_add_epi32(ch, _mm256_add_epi32(
+                                          _mm256_set1_epi32(int32_t(kRoundConstants[t])), w[t])));
+        __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(Rotr8(a, 2), Rotr8(a, 13)), Rotr8(a, 22));
+        __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)),
+                                       _mm256_and_si256(b, c));
+        __m256i t2 = _mm256_add_epi32(sigma0, maj);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, t2);
+    }
+    v[0] = _mm256_add_epi32(v[0], a);
+    v[1] = _mm256_add_epi32(v[1], b);
+    v[2] = _mm256_add_epi32(v[2], c);
+    v[3] = _mm256_add_epi32(v[3], d);
+    v[4] = _mm256_add_epi32(v[4], e);
+    v[5] = _mm256_add_epi32(v[5], f);
+    v[6] = _mm256_add_epi32(v[6], g);
+    v[7] = _mm256_add_epi32(v[7], h);
+    for (int i = 0; i < 8; i++)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[i]), v[i]);
+}
+#endif
+
+}  // namespace sha256_multibuffer
+
+inline bool IsSha256BackendAvailable(Sha256Backend backend) {
+#if SHA256_HAS_AVX2_LANES
+    if (backend == Sha256Backend::kAvx2)
+        return hasAVX2();
+#else
+    if (backend == Sha256Backend::kAvx2)
+        return false;
+#endif
+    return true;
+}
+
+// AVX2 when the CPU has it and CHIA_DISABLE_AVX2 is not set.
+inline Sha256Backend GetDefaultSha256Backend() {
+    return IsSha256BackendAvailable(Sha256Backend::kAvx2) ? Sha256Backend::kAvx2 : Sha256Backend::kScalar;
+}
+
+// Increments sprout as a big-endian counter `count` times and writes the
+// SHA-256 digest of each value to out, 32 bytes each, in order. An
+// unavailable backend falls back to kScalar.
+inline void HashCounterRun(std::vector<uint8_t>& sprout, size_t count, uint8_t* out,
+                           Sha256Backend backend = GetDefaultSha256Backend()) {
+    using namespace sha256_multibuffer;
+    if (count == 0)
+        return;
+    const size_t len = sprout.size();
+    std::vector<uint8_t> messages(count * len);
+    for (size_t m = 0; m < count; m++) {
+        for (int i = (int) len - 1; i >= 0; --i) {
+            sprout[i]++;
+            if (sprout[i])
+                break;
+        }
+        std::copy(sprout.begin(), sprout.end(), messages.begin() + m * len);
+    }
+
+    // Blocks every message shares go into the midstate.
+    size_t prefix = len;
+    for (size_t m = 1; m < count; m++) {
+        const uint8_t* first = messages.data();
+        const uint8_t* message = messages.data() + m * len;
+        prefix = std::mismatch(first, first + prefix, message).first - first;
+    }
+    size_t midstate_blocks = prefix / 64;
+    uint32_t midstate[8];
+    std::copy(kInitialState, kInitialState + 8, midstate);
+    for (size_t i = 0; i < midstate_blocks; i++)
+        Compress(midstate, messages.data() + 64 * i);
+
+    // Padded remainder of each message.
+    size_t tail_len = len - 64 * midstate_blocks;
+    size_t tail_blocks = (tail_len + 9 + 63) / 64;
+    std::vector<uint8_t> tails(count * tail_blocks * 64, 0);
+    uint64_t bit_len = uint64_t(len) * 8;
+    for (size_t m = 0; m < count; m++) {
+        uint8_t* tail = tails.data() + m * tail_blocks * 64;
+        const uint8_t* message = messages.data() + m * len + 64 * midstate_blocks;
+        std::copy(message, message + tail_len, tail);
+        tail[tail_len] = 0x80;
+        for (int i = 0; i < 8; i++)
+            tail[tail_blocks * 64 - 1 - i] = uint8_t(bit_len >> (8 * i));
+    }
+
+    size_t done = 0;
+#if SHA256_HAS_AVX2_LANES
+    if (backend == Sha256Backend::kAvx2 && IsSha256BackendAvailable(backend)) {
+        for (; done < count; done += kLanes) {
+            uint32_t state[8][kLanes];
+            for (int i = 0; i < 8; i++)
+                std::fill(state[i], state[i] + kLanes, midstate[i]);
+            for (size_t block = 0; block < tail_blocks; block++) {
+                // Lanes past the end repeat the last message.
+                const uint8_t* blocks[kLanes];
+                for (int lane = 0; lane < kLanes; lane++) {
+                    size_t m = std::min(done + lane, count - 1);
+                    blocks[lane] = tails.data() + (m * tail_blocks + block) * 64;
+                }
+                Compress8(state, blocks);
+            }
+            for (int lane = 0; lane < kLanes && done + lane < count; lane++) {
+                for (int i = 0; i < 8; i++)
+                    StoreBigEndian(out + 32 * (done + lane) + 4 * i, state[i][lane]);
+            }
+        }
+    }
+#endif
+    for (; done < count; done++) {
+        uint32_t state[8];
+        std::copy(midstate, midstate + 8, state);
+        for (size_t block = 0; block < tail_blocks; block++)
+            Compress(state, tails.data() + (done * tail_blocks + block) * 64);
+        for (int i = 0; i < 8; i++)
+            StoreBigEndian(out + 32 * done + 4 * i, state[i]);
+    }
+}
+
+#endif // SHA256_MULTIBUFFER_H
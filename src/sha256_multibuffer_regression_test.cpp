@@ -0,0 +1,77 @@
+#include "verifier.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+std::vector<Sha256Backend> available_sha256_backends() {
+    std::vector<Sha256Backend> backends;
+    for (Sha256Backend backend : {Sha256Backend::kScalar, Sha256Backend::kAvx2}) {
+        if (IsSha256BackendAvailable(backend))
+            backends.push_back(backend);
+    }
+    return backends;
+}
+
+// picosha2 on each increment of sprout, as HashPrime used to hash.
+std::vector<uint8_t> reference_counter_run(std::vector<uint8_t> sprout, size_t count) {
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> hash(picosha2::k_digest_size);
+    for (size_t m = 0; m < count; m++) {
+        for (int i = (int) sprout.size() - 1; i >= 0; --i) {
+            sprout[i]++;
+            if (sprout[i])
+                break;
+        }
+        picosha2::hash256(sprout.begin(), sprout.end(), hash.begin(), hash.end());
+        out.insert(out.end(), hash.begin(), hash.end());
+    }
+    return out;
+}
+
+void expect_counter_run_matches(const std::vector<uint8_t>& seed, size_t count) {
+    std::vector<uint8_t> expected = reference_counter_run(seed, count);
+    for (Sha256Backend backend : available_sha256_backends()) {
+        std::vector<uint8_t> sprout = seed;
+        std::vector<uint8_t> out(32 * count);
+        HashCounterRun(sprout, count, out.data(), backend);
+        EXPECT_EQ(out, expected) << "backend " << int(backend) << ", length " << seed.size() << ", count " << count;
+        std::vector<uint8_t> last = seed;
+        for (size_t m = 0; m < count; m++) {
+            for (int i = (int) last.size() - 1; i >= 0; --i) {
+                last[i]++;
+                if (last[i])
+                    break;
+            }
+        }
+        EXPECT_EQ(sprout, last);
+    }
+}
+
+}  // namespace
+
+TEST(Sha256MultibufferRegressionTest, MatchesPicosha2AcrossLengths) {
+    // Lengths around the 55, 64 and 119 byte padding boundaries, and the
+    // 200 byte GetB seed.
+    for (size_t len = 0; len <= 200; len++) {
+        std::vector<uint8_t> seed(len);
+        for (size_t i = 0; i < len; i++)
+            seed[i] = uint8_t(31 * i + len);
+        expect_counter_run_matches(seed, len % 19 + 1);
+    }
+}
+
+TEST(Sha256MultibufferRegressionTest, CarriesPastTheMidstate) {
+    // The counter carries into the shared blocks partway through the run.
+    std::vector<uint8_t> seed(150, 0x11);
+    for (size_t i = 64; i < seed.size(); i++)
+        seed[i] = 0xff;
+    seed.back() = 0xf0;
+    expect_counter_run_matches(seed, 40);
+
+    // The whole sprout wraps to zero.
+    expect_counter_run_matches(std::vector<uint8_t>(70, 0xff), 9);
+}
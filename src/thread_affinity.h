@@ -0,0 +1,363 @@
+#ifndef THREAD_AFFINITY_H
+#define THREAD_AFFINITY_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+// Placement of the VDF squaring threads. The fast squaring loop runs as a
+// master/slave pair spinning on shared counters, so it is fastest with both
+// threads on one physical core (hyperthread siblings) or on cores sharing
+// L2, and with nothing else scheduled there. Everything else (provers,
+// intermediates storage) inherits a mask that excludes those cores.
+//
+// Set with CHIAVDF_THREAD_AFFINITY:
+//   unset / "off"  no pinning
+//   "auto"         choose from the sysfs topology
+//   "M,S[,M,S...]" master on cpu M, slave on cpu S, one pair per
+//                  concurrent VDF loop
+// Only Linux is supported; elsewhere the policy is always off.
+
+const char kThreadAffinityEnv[] = "CHIAVDF_THREAD_AFFINITY";
+
+struct CpuInfo {
+    int cpu;
+    int package;
+    int node;
+    // Hyperthreads of the same core, including cpu itself.
+    std::vector<int> siblings;
+    // CPUs sharing cpu's L2 cache, including cpu itself.
+    std::vector<int> l2_shared;
+};
+
+// CPUs of the two threads of one VDF squaring loop.
+struct VdfCpuPair {
+    int master = -1;
+    int slave = -1;
+    // How the CPUs relate, for the startup report.
+    std::string relation;
+};
+
+struct ThreadPlacement {
+    // Pair i is used by the squaring loop with pair index i.
+    std::vector<VdfCpuPair> vdf_pairs;
+    // CPUs for every other thread; empty leaves them unrestricted.
+    std::vector<int> other_cpus;
+    // CPUs the process was allowed to run on before pinning.
+    std::vector<int> allowed_cpus;
+    std::string description = "thread affinity off";
+
+    bool IsActive() const {
+        return !vdf_pairs.empty();
+    }
+};
+
+// Parses a sysfs cpu list such as "0-3,8,10-11".
+inline std::vector<int> ParseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        range.erase(std::remove_if(range.begin(), range.end(), ::isspace), range.end());
+        if (range.empty())
+            continue;
+        size_t dash = range.find('-');
+        try {
+            int first = std::stoi(range.substr(0, dash));
+            int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++)
+                cpus.push_back(cpu);
+        } catch (std::exception&) {
+            return {};
+        }
+    }
+    return cpus;
+}
+
+inline std::string FormatCpuList(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        if (!out.empty())
+            out += ",";
+        out += std::to_string(cpus[i]);
+        if (j > i)
+            out += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+// Reserves the cores of the VDF pairs and leaves the remaining CPUs to the
+// other threads.
+inline ThreadPlacement MakeThreadPlacement(const std::vector<CpuInfo>& cpus, const std::vector<VdfCpuPair>& pairs) {
+    ThreadPlacement placement;
+    placement.vdf_pairs = pairs;
+    std::set<int> reserved;
+    std::map<int, int> node_of;
+    for (const CpuInfo& info : cpus)
+        node_of[info.cpu] = info.node;
+    for (const VdfCpuPair& pair : pairs) {
+        reserved.insert(pair.master);
+        reserved.insert(pair.slave);
+        for (const CpuInfo& info : cpus) {
+            if (info.cpu == pair.master || info.cpu == pair.slave)
+                reserved.insert(info.siblings.begin(), info.siblings.end());
+        }
+    }
+    for (const CpuInfo& info : cpus) {
+        placement.allowed_cpus.push_back(info.cpu);
+        if (!reserved.count(info.cpu))
+            placement.other_cpus.push_back(info.cpu);
+    }
+    for (size_t i = 0; i < pairs.size(); i++) {
+        placement.description += (i == 0) ? "VDF" : ";";
+        placement.description += " master on cpu " + std::to_string(pairs[i].master) + ", slave on cpu " +
+                                 std::to_string(pairs[i].slave) + " (" + pairs[i].relation;
+        if (node_of.count(pairs[i].master))
+            placement.description += ", node " + std::to_string(node_of[pairs[i].master]);
+        placement.description += ")";
+    }
+    placement.description += "; other threads on cpus " +
+                             (placement.other_cpus.empty() ? std::string("any") : FormatCpuList(placement.other_cpus));
+    return placement;
+}
+
+// Picks a VDF pair on the first NUMA node of cpus: the last core there (cpu
+// 0 tends to take interrupts), with its hyperthread sibling, else a CPU
+// sharing its L2, else the previous core. cpus must be sorted.
+inline bool ChooseVdfCpuPair(const std::vector<CpuInfo>& cpus, VdfCpuPair& pair) {
+    if (cpus.size() < 2)
+        return false;
+    std::set<int> allowed;
+    for (const CpuInfo& info : cpus)
+        allowed.insert(info.cpu);
+    auto core_of = [&](const CpuInfo& info) {
+        for (int cpu : info.siblings) {
+            if (allowed.count(cpu))
+                return std::min(cpu, info.cpu);
+        }
+        return info.cpu;
+    };
+
+    int node = cpus[0].node;
+    // Cores of the first node, keyed by their lowest allowed CPU.
+    std::map<int, const CpuInfo*> cores;
+    for (const CpuInfo& info : cpus) {
+        if (info.node == node && !cores.count(core_of(info)))
+            cores[core_of(info)] = &info;
+    }
+    const CpuInfo& master = *cores.rbegin()->second;
+    pair.master = cores.rbegin()->first;
+
+    for (int cpu : master.siblings) {
+        if (cpu != pair.master && allowed.count(cpu)) {
+            pair.slave = cpu;
+            pair.relation = "hyperthread sibling";
+            return true;
+        }
+    }
+    for (int cpu : master.l2_shared) {
+        if (cpu != pair.master && allowed.count(cpu)) {
+            pair.slave = cpu;
+            pair.relation = "shared L2";
+            return true;
+        }
+    }
+    if (cores.size() >= 2) {
+        pair.slave = std::next(cores.rbegin())->first;
+        pair.relation = "adjacent core";
+        return true;
+    }
+    for (const CpuInfo& info : cpus) {
+        if (info.cpu != pair.master) {
+            pair.slave = info.cpu;
+            pair.relation = "other node";
+            return true;
+        }
+    }
+    return false;
+}
+
+// Picks up to max_pairs VDF pairs, one per concurrent VDF loop, each on
+// cores of its own.
+inline ThreadPlacement ChooseThreadPlacement(std::vector<CpuInfo> cpus, int max_pairs = 1) {
+    std::sort(cpus.begin(), cpus.end(), [](const CpuInfo& a, const CpuInfo& b) { return a.cpu < b.cpu; });
+    std::vector<VdfCpuPair> pairs;
+    std::vector<CpuInfo> free_cpus = cpus;
+    VdfCpuPair pair;
+    while (static_cast<int>(pairs.size()) < max_pairs && ChooseVdfCpuPair(free_cpus, pair)) {
+        pairs.push_back(pair);
+        std::set<int> taken = {pair.master, pair.slave};
+        for (const CpuInfo& info : free_cpus) {
+            if (info.cpu == pair.master || info.cpu == pair.slave)
+                taken.insert(info.siblings.begin(), info.siblings.end());
+        }
+        free_cpus.erase(std::remove_if(free_cpus.begin(), free_cpus.end(),
+                                       [&](const CpuInfo& info) { return taken.count(info.cpu) != 0; }),
+                        free_cpus.end());
+    }
+    if (pairs.empty()) {
+        ThreadPlacement placement;
+        placement.description = "thread affinity off: fewer than 2 CPUs";
+        return placement;
+    }
+    return MakeThreadPlacement(cpus, pairs);
+}
+
+inline ThreadPlacement& GetThreadPlacement() {
+    static ThreadPlacement placement;
+    return placement;
+}
+
+#if defined(__linux__)
+inline std::string ReadSysfsLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// Topology of the CPUs this process may run on.
+inline std::vector<CpuInfo> ReadCpuTopology() {
+    std::vector<CpuInfo> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+        return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set))
+            continue;
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = std::atoi(ReadSysfsLine(dir + "/topology/physical_package_id").c_str());
+        info.node = 0;
+        if (DIR* d = opendir(dir.c_str())) {
+            while (dirent* entry = readdir(d)) {
+                std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+                    name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                    info.node = std::atoi(name.c_str() + 4);
+                }
+            }
+            closedir(d);
+        }
+        info.siblings = ParseCpuList(ReadSysfsLine(dir + "/topology/thread_siblings_list"));
+        if (info.siblings.empty())
+            info.siblings.push_back(cpu);
+        for (int index = 0;; index++) {
+            std::string cache = dir + "/cache/index" + std::to_string(index);
+            std::string level = ReadSysfsLine(cache + "/level");
+            if (level.empty())
+                break;
+            if (level == "2") {
+                info.l2_shared = ParseCpuList(ReadSysfsLine(cache + "/shared_cpu_list"));
+                break;
+            }
+        }
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+inline bool SetCurrentThreadCpus(const std::vector<int>& cpus) {
+    if (cpus.empty())
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+#else
+inline std::vector<CpuInfo> ReadCpuTopology() {
+    return {};
+}
+
+inline bool SetCurrentThreadCpus(const std::vector<int>&) {
+    return false;
+}
+#endif
+
+// Chooses the placement from CHIAVDF_THREAD_AFFINITY, with up to max_pairs
+// VDF pairs for "auto", and restricts the calling thread, and so every
+// thread it starts later, to the CPUs left for provers and storage. Call
+// once at startup, before starting threads. Returns a line describing the
+// placement.
+inline std::string ConfigureThreadPlacement(int max_pairs = 1) {
+    ThreadPlacement& placement = GetThreadPlacement();
+    placement = ThreadPlacement();
+    const char* value = std::getenv(kThreadAffinityEnv);
+    std::string policy = (value != nullptr) ? value : "";
+    if (policy.empty() || policy == "off" || policy == "0")
+        return placement.description;
+#if !defined(__linux__)
+    placement.description = "thread affinity off: only supported on Linux";
+    return placement.description;
+#else
+    std::vector<CpuInfo> cpus = ReadCpuTopology();
+    if (policy == "auto") {
+        placement = ChooseThreadPlacement(cpus, max_pairs);
+    } else {
+        std::vector<int> list = ParseCpuList(policy);
+        std::set<int> distinct(list.begin(), list.end());
+        bool known = !list.empty() && list.size() % 2 == 0 && distinct.size() == list.size();
+        for (size_t i = 0; known && i < list.size(); i++) {
+            known = std::any_of(cpus.begin(), cpus.end(), [&](const CpuInfo& info) { return info.cpu == list[i]; });
+        }
+        if (!known) {
+            placement.description = "thread affinity off: expected \"auto\" or pairs of allowed cpus \"M,S\", got \"" +
+                                    policy + "\"";
+            return placement.description;
+        }
+        std::vector<VdfCpuPair> pairs;
+        for (size_t i = 0; i < list.size(); i += 2)
+            pairs.push_back({list[i], list[i + 1], "configured"});
+        placement = MakeThreadPlacement(cpus, pairs);
+    }
+    if (placement.IsActive())
+        SetCurrentThreadCpus(placement.other_cpus);
+    return placement.description;
+#endif
+}
+
+// Moves the calling thread off the VDF cores. For worker threads, which may
+// be started from the pinned VDF thread and would inherit its CPU.
+inline void PinWorkerThread() {
+    const ThreadPlacement& placement = GetThreadPlacement();
+    if (!placement.IsActive())
+        return;
+    SetCurrentThreadCpus(placement.other_cpus.empty() ? placement.allowed_cpus : placement.other_cpus);
+}
+
+// Pins the calling thread of the VDF squaring loop with the given pair
+// index to its CPU, if a placement is active. Loops without a pair of their
+// own run with the other threads.
+inline void PinVdfThread(bool is_master, int pair_index = 0) {
+    const ThreadPlacement& placement = GetThreadPlacement();
+    if (!placement.IsActive())
+        return;
+    if (pair_index >= static_cast<int>(placement.vdf_pairs.size())) {
+        PinWorkerThread();
+        return;
+    }
+    const VdfCpuPair& pair = placement.vdf_pairs[pair_index];
+    SetCurrentThreadCpus({is_master ? pair.master : pair.slave});
+}
+
+#endif // THREAD_AFFINITY_H
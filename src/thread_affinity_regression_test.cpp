@@ -0,0 +1,106 @@
+#include "thread_affinity.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace {
+
+// Two-node machine, four cores per node, two hyperthreads per core
+// (cpu n and n + 8 are siblings), pairs of cores sharing L2.
+std::vector<CpuInfo> make_smt_topology() {
+    std::vector<CpuInfo> cpus;
+    for (int cpu = 0; cpu < 16; cpu++) {
+        int core = cpu % 8;
+        int l2 = core - core % 2;
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = core / 4;
+        info.node = core / 4;
+        info.siblings = {core, core + 8};
+        info.l2_shared = {l2, l2 + 1, l2 + 8, l2 + 9};
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+std::vector<CpuInfo> make_flat_topology(int n, bool shared_l2) {
+    std::vector<CpuInfo> cpus;
+    for (int cpu = 0; cpu < n; cpu++) {
+        CpuInfo info;
+        info.cpu = cpu;
+        info.package = 0;
+        info.node = 0;
+        info.siblings = {cpu};
+        if (shared_l2)
+            info.l2_shared = {cpu - cpu % 2, cpu - cpu % 2 + 1};
+        else
+            info.l2_shared = {cpu};
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+}  // namespace
+
+TEST(ThreadAffinityRegressionTest, ParsesAndFormatsCpuLists) {
+    EXPECT_EQ(ParseCpuList("0-3,8,10-11\n"), std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(ParseCpuList("5"), std::vector<int>({5}));
+    EXPECT_TRUE(ParseCpuList("").empty());
+    EXPECT_TRUE(ParseCpuList("a-b").empty());
+    EXPECT_EQ(FormatCpuList({0, 1, 2, 3, 8, 10, 11}), "0-3,8,10-11");
+}
+
+TEST(ThreadAffinityRegressionTest, PrefersHyperthreadSiblingsOnFirstNode) {
+    ThreadPlacement placement = ChooseThreadPlacement(make_smt_topology());
+    ASSERT_TRUE(placement.IsActive());
+    EXPECT_EQ(placement.vdf_pairs[0].master, 3);
+    EXPECT_EQ(placement.vdf_pairs[0].slave, 11);
+    EXPECT_EQ(placement.other_cpus, ParseCpuList("0-2,4-10,12-15"));
+}
+
+TEST(ThreadAffinityRegressionTest, FallsBackToSharedL2ThenAdjacentCore) {
+    ThreadPlacement l2 = ChooseThreadPlacement(make_flat_topology(4, true));
+    ASSERT_TRUE(l2.IsActive());
+    EXPECT_EQ(l2.vdf_pairs[0].master, 3);
+    EXPECT_EQ(l2.vdf_pairs[0].slave, 2);
+    EXPECT_EQ(l2.other_cpus, std::vector<int>({0, 1}));
+
+    ThreadPlacement adjacent = ChooseThreadPlacement(make_flat_topology(4, false));
+    ASSERT_TRUE(adjacent.IsActive());
+    EXPECT_EQ(adjacent.vdf_pairs[0].master, 3);
+    EXPECT_EQ(adjacent.vdf_pairs[0].slave, 2);
+
+    // With only the VDF pair, other threads stay unrestricted.
+    ThreadPlacement pair = ChooseThreadPlacement(make_flat_topology(2, false));
+    ASSERT_TRUE(pair.IsActive());
+    EXPECT_TRUE(pair.other_cpus.empty());
+    EXPECT_EQ(pair.allowed_cpus, std::vector<int>({0, 1}));
+
+    EXPECT_FALSE(ChooseThreadPlacement(make_flat_topology(1, false)).IsActive());
+}
+
+TEST(ThreadAffinityRegressionTest, OnlyUsesAllowedCpus) {
+    // The process may not run on cpu 11, the sibling of the last core.
+    std::vector<CpuInfo> cpus = make_smt_topology();
+    cpus.erase(cpus.begin() + 11);
+    ThreadPlacement placement = ChooseThreadPlacement(cpus);
+    ASSERT_TRUE(placement.IsActive());
+    EXPECT_EQ(placement.vdf_pairs[0].master, 3);
+    EXPECT_EQ(placement.vdf_pairs[0].slave, 2);
+}
+
+TEST(ThreadAffinityRegressionTest, GivesEachVdfLoopItsOwnCores) {
+    ThreadPlacement placement = ChooseThreadPlacement(make_smt_topology(), 2);
+    ASSERT_EQ(placement.vdf_pairs.size(), 2u);
+    EXPECT_EQ(placement.vdf_pairs[1].master, 2);
+    EXPECT_EQ(placement.vdf_pairs[1].slave, 10);
+    EXPECT_EQ(placement.other_cpus, ParseCpuList("0-1,4-9,12-15"));
+
+    // Stops when the CPUs run out.
+    ThreadPlacement flat = ChooseThreadPlacement(make_flat_topology(4, false), 3);
+    ASSERT_EQ(flat.vdf_pairs.size(), 2u);
+    EXPECT_EQ(flat.vdf_pairs[1].master, 1);
+    EXPECT_EQ(flat.vdf_pairs[1].slave, 0);
+    EXPECT_TRUE(flat.other_cpus.empty());
+}
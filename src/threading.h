@@ -3,6 +3,7 @@
 
 #include "alloc.hpp"
 #include <atomic>
+#include <stdexcept>
 
 //mp_limb_t is an unsigned integer
 static_assert(sizeof(mp_limb_t)==8, "");
@@ -566,8 +567,54 @@ struct alignas(64) thread_counter {
     }
 };
 
-thread_counter master_counter[100];
-thread_counter slave_counter[100];
+const int kMaxSquarePairs = 100;
+
+thread_counter master_counter[kMaxSquarePairs];
+thread_counter slave_counter[kMaxSquarePairs];
+
+// Reserves a pair index, i.e. a master/slave counter pair, for the lifetime
+// of one squaring loop. Loops running at the same time in one process, one
+// per session, need distinct indexes.
+class ScopedSquarePairIndex {
+  public:
+    ScopedSquarePairIndex() {
+        std::lock_guard<std::mutex> lk(Mutex());
+        std::vector<bool>& used = Used();
+        for (int i = 0; i < kMaxSquarePairs; i++) {
+            if (!used[i]) {
+                used[i] = true;
+                index = i;
+                return;
+            }
+        }
+        throw std::runtime_error("Too many concurrent VDF loops");
+    }
+
+    ~ScopedSquarePairIndex() {
+        std::lock_guard<std::mutex> lk(Mutex());
+        Used()[index] = false;
+    }
+
+    ScopedSquarePairIndex(const ScopedSquarePairIndex&) = delete;
+    ScopedSquarePairIndex& operator=(const ScopedSquarePairIndex&) = delete;
+
+    int get() const {
+        return index;
+    }
+
+  private:
+    int index = 0;
+
+    static std::mutex& Mutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<bool>& Used() {
+        static std::vector<bool> used(kMaxSquarePairs, false);
+        return used;
+    }
+};
 
 struct thread_state {
     int pairindex;
@@ -0,0 +1,19 @@
+#include "vdf.h"
+
+#include <gtest/gtest.h>
+
+#if (defined(ARCH_X86) || defined(ARCH_X64)) && !defined(CHIA_DISABLE_ASM)
+// Sessions of a vdf_client server square at the same time, each on its own
+// master/slave counter pair.
+TEST(ThreadingRegressionTest, ConcurrentSquaringLoopsGetDistinctPairIndexes) {
+    ScopedSquarePairIndex first;
+    int reused;
+    {
+        ScopedSquarePairIndex second;
+        EXPECT_NE(first.get(), second.get());
+        reused = second.get();
+    }
+    ScopedSquarePairIndex third;
+    EXPECT_EQ(third.get(), reused);
+}
+#endif
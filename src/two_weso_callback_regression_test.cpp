@@ -3,8 +3,10 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
 #include <cstdint>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 // Needed by headers pulled in via vdf.h (declared extern in parameters.h).
@@ -70,3 +72,88 @@ TEST(TwoWesolowskiCallbackRegressionTest, RejectsOutOfBoundsFormLookupAtCapacity
     EXPECT_NO_THROW((void)callback.GetFormCopy(static_cast<uint64_t>(kMaxItersAllowed - 100)));
     EXPECT_THROW((void)callback.GetFormCopy(static_cast<uint64_t>(kMaxItersAllowed)), std::runtime_error);
 }
+
+TEST(TwoWesolowskiCallbackRegressionTest, HidesCheckpointsAboveWatermark) {
+    integer d = make_fixture_discriminant();
+    form f = form::generator(d);
+    TwoWesolowskiCallback callback(d, f);
+
+    EXPECT_EQ(callback.GetFormCopy(0), f);
+    form y = f;
+    for (uint64_t i = 0; i < 10; i++) {
+        nudupl_form(y, y, d, callback.L);
+        callback.reducer->reduce(y);
+    }
+    // OnIteration reports the form after iteration + 1 squarings.
+    callback.OnIteration(NL_FORM, &y, 9);
+    EXPECT_EQ(callback.GetFormCopy(10).a, integer(0));
+    callback.iterations = 10;
+    EXPECT_EQ(callback.GetFormCopy(10), y);
+}
+
+TEST(TwoWesolowskiCallbackRegressionTest, ReadersSeePublishedCheckpointsWhileWriting) {
+    integer d = make_fixture_discriminant();
+    form f = form::generator(d);
+    TwoWesolowskiCallback callback(d, f);
+
+    const uint64_t total = 4000;
+    std::vector<form> expected;
+    form y = f;
+    PulmarkReducer reducer;
+    for (uint64_t i = 0; i <= total; i++) {
+        if (i % 10 == 0)
+            expected.push_back(y);
+        nudupl_form(y, y, d, callback.L);
+        reducer.reduce(y);
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 3; t++) {
+        readers.emplace_back([&, t]() {
+            uint64_t probe = t;
+            while (!done.load()) {
+                const uint64_t published = static_cast<uint64_t>(callback.iterations.load());
+                const uint64_t power = (probe++ * 70) % (published + 1);
+                const uint64_t checkpoint = power - power % 10;
+                if (!(callback.GetFormCopy(checkpoint) == expected[checkpoint / 10]))
+                    mismatches++;
+            }
+        });
+    }
+
+    form g = f;
+    for (uint64_t i = 0; i < total; i++) {
+        nudupl_form(g, g, d, callback.L);
+        reducer.reduce(g);
+        callback.OnIteration(NL_FORM, &g, i);
+        if ((i + 1) % 100 == 0)
+            callback.iterations = static_cast<int64_t>(i + 1);
+    }
+    done = true;
+    for (std::thread& t : readers)
+        t.join();
+    EXPECT_EQ(mismatches.load(), 0);
+    EXPECT_EQ(callback.GetFormCopy(total), expected[total / 10]);
+}
+
+TEST(TwoWesolowskiCallbackRegressionTest, WaitForIterationsWakesOnPublishAndStop) {
+    integer d = make_fixture_discriminant();
+    form f = form::generator(d);
+    TwoWesolowskiCallback callback(d, f);
+    std::atomic<bool> stop{false};
+
+    bool reached = false;
+    std::thread waiter([&]() { reached = callback.WaitForIterations(1000, stop); });
+    callback.PublishIterations(500);
+    callback.PublishIterations(1000);
+    waiter.join();
+    EXPECT_TRUE(reached);
+    EXPECT_TRUE(callback.WaitForIterations(10, stop));
+
+    std::thread stopped_waiter([&]() { reached = callback.WaitForIterations(5000, stop); });
+    stop = true;
+    stopped_waiter.join();
+    EXPECT_FALSE(reached);
+}
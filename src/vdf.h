@@ -58,7 +58,9 @@
 #include <memory>
 #include <condition_variable>
 #include "proof_common.h"
+#include "verifier.h"
 #include "provers.h"
+#include "prover_pool.h"
 #include "util.h"
 #include "callback.h"
 #include "fast_storage.h"
@@ -82,14 +84,16 @@ struct akashnil_form {
 const int64_t THRESH = 1UL<<31;
 const int64_t EXP_THRESH = 31;
 
-// Notifies ProverManager class each time there's a new event.
-bool new_event = false;
-std::condition_variable new_event_cv;
-std::mutex new_event_mutex, cout_lock;
+std::mutex cout_lock;
 
 bool debug_mode = false;
-bool fast_algorithm = false;
-bool two_weso = false;
+
+// Threads per proof for bucket accumulation, see Prover::SetBucketThreads.
+// Configured with CHIAVDF_PROVER_BUCKET_THREADS; defaults to 1.
+uint32_t GetProverBucketThreads() {
+    static const uint32_t bucket_threads = env_uint32("CHIAVDF_PROVER_BUCKET_THREADS", 1);
+    return bucket_threads;
+}
 
 //always works
 void repeated_square_original(vdf_original &vdfo, form& f, const integer&, const integer&, uint64 base, uint64 iterations, INUDUPLListener *nuduplListener) {
@@ -126,12 +130,8 @@ static inline void repeated_square_nudupl(
     INUDUPLListener* nuduplListener
 ) {
     vdf_original::form f_view;
-    // Defensive fallback: if `weso` is null, use a Pulmark reducer.
-    // Construct it once per call (it does heap work) rather than per reduction.
-    std::optional<PulmarkReducer> fallback_reducer;
-    if (weso == nullptr) {
-        fallback_reducer.emplace();
-    }
+    // Defensive fallback: if `weso` is null, use this thread's Pulmark reducer.
+    PulmarkReducer* fallback_reducer = weso ? nullptr : &GetThreadPulmarkReducer();
     for (uint64_t i = 0; i < iterations; i++) {
         nudupl_form(f, f, D, L);
 
@@ -157,7 +157,9 @@ static inline void repeated_square_nudupl(
 }
 
 // thread safe; but it is only called from the main thread
-void repeated_square(uint64_t iterations, form f, const integer& D, const integer& L,
+// f is the form after start_iteration squarings; start_iteration must be a
+// multiple of 2^16 (0 for a new chain).
+void repeated_square_from(uint64_t start_iteration, uint64_t iterations, form f, const integer& D, const integer& L,
     WesolowskiCallback* weso, FastStorage* fast_storage, std::atomic<bool>& stopped)
 {
     #ifdef VDF_TEST
@@ -166,8 +168,13 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
         uint64 num_iterations_slow=0;
     #endif
 
-    uint64_t num_iterations = 0;
-    uint64_t last_checkpoint = 0;
+    uint64_t num_iterations = start_iteration;
+    uint64_t last_checkpoint = start_iteration;
+    // The session kind follows from the callback, so several sessions can
+    // run in one process.
+    FastAlgorithmCallback* fast_weso = dynamic_cast<FastAlgorithmCallback*>(weso);
+    TwoWesolowskiCallback* nweso = dynamic_cast<TwoWesolowskiCallback*>(weso);
+    ScopedSquarePairIndex pair_index;
 
     while (!stopped) {
         uint64 c_checkpoint_interval=checkpoint_interval;
@@ -198,7 +205,7 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
 #if (defined(ARCH_X86) || defined(ARCH_X64)) && !defined(CHIA_DISABLE_ASM)
         // x86/x64: use the phased pipeline.
         square_state_type square_state;
-        square_state.pairindex = 0;
+        square_state.pairindex = pair_index.get();
         actual_iterations = repeated_square_fast(square_state, f, D, L, num_iterations, batch_size, weso);
 #else
         // Non-x86: use the C++ NUDUPL path (faster and lower maintenance than the phased pipeline).
@@ -249,25 +256,20 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
 
         num_iterations+=actual_iterations;
         if (num_iterations >= last_checkpoint) {
-            weso->iterations = num_iterations;
+            weso->PublishIterations(num_iterations);
 
             // n-weso specific logic.
-            if (fast_algorithm) {
+            if (fast_weso != nullptr) {
                 if (fast_storage != NULL) {
-                    fast_storage->SubmitCheckpoint(static_cast<FastAlgorithmCallback*> (weso)->y_ret, last_checkpoint);
+                    fast_storage->SubmitCheckpoint(fast_weso->y_ret, last_checkpoint);
                 } else if (last_checkpoint % (1 << 16) == 0) {
                     // Notify prover event loop, we have a new segment with intermediates stored.
-                    {
-                        std::lock_guard<std::mutex> lk(new_event_mutex);
-                        new_event = true;
-                    }
-                    new_event_cv.notify_all();
+                    fast_weso->NotifyEvent();
                 }
             }
 
             // 2-weso specific logic.
-            if (two_weso) {
-                TwoWesolowskiCallback* nweso = (TwoWesolowskiCallback*) weso;
+            if (nweso != nullptr) {
                 if (num_iterations >= kSwitchIters && !nweso->LargeConstants()) {
                     uint64 round_up = (100 - num_iterations % 100) % 100;
                     if (round_up > 0) {
@@ -275,7 +277,7 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
                     }
                     num_iterations += round_up;
                     nweso->IncreaseConstants(num_iterations);
-                    weso->iterations = num_iterations;
+                    weso->PublishIterations(num_iterations);
                 }
                 if (num_iterations >= kMaxItersAllowed - 500000) {
                     std::cout << "Maximum possible number of iterations reached!\n";
@@ -287,7 +289,7 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
         }
 
         if (iterations != 0 && num_iterations > iterations) {
-            weso->iterations = num_iterations;
+            weso->PublishIterations(num_iterations);
             break;
         }
 
@@ -301,6 +303,8 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
             }
         #endif
     }
+    // Wake proof threads waiting for iterations that will never come.
+    weso->PublishIterations(num_iterations);
     {
         // this shouldn't be needed but avoids some false positive in TSAN
         std::lock_guard<std::mutex> lk(cout_lock);
@@ -313,12 +317,16 @@ void repeated_square(uint64_t iterations, form f, const integer& D, const intege
     #endif
 }
 
+void repeated_square(uint64_t iterations, form f, const integer& D, const integer& L,
+    WesolowskiCallback* weso, FastStorage* fast_storage, std::atomic<bool>& stopped)
+{
+    repeated_square_from(0, iterations, f, D, L, weso, fast_storage, stopped);
+}
+
 Proof ProveOneWesolowski(uint64_t iters, integer& D, form f, OneWesolowskiCallback* weso,
     std::atomic<bool>& stopped)
 {
-    while (!stopped && weso->iterations < iters) {
-        this_thread::sleep_for(1s);
-    }
+    weso->WaitForIterations(iters, stopped);
     if (stopped)
         return Proof();
     Segment sg(
@@ -328,10 +336,10 @@ Proof ProveOneWesolowski(uint64_t iters, integer& D, form f, OneWesolowskiCallba
         /*y=*/weso->result
     );
     OneWesolowskiProver prover(sg, D, weso->forms.get(), stopped);
+    prover.SetBucketThreads(GetProverBucketThreads());
     prover.start();
-    while (!prover.IsFinished()) {
-        this_thread::sleep_for(1s);
-    }
+    if (!prover.WaitForFinish(stopped))
+        return Proof();
     int d_bits = D.num_bits();
     std::vector<unsigned char> y_serialized;
     std::vector<unsigned char> proof_serialized;
@@ -353,9 +361,7 @@ Proof ProveTwoWeso(integer& D, form x, uint64_t iters, uint64_t done_iterations,
 {
     integer L=root(-D, 4);
     if (depth == 2) {
-        while (!stop_signal && weso->iterations < done_iterations + iters) {
-            std::this_thread::sleep_for (std::chrono::milliseconds(200));
-        }
+        weso->WaitForIterations(done_iterations + iters, stop_signal);
         if (stop_signal)
             return Proof();
 
@@ -371,6 +377,7 @@ Proof ProveTwoWeso(integer& D, form x, uint64_t iters, uint64_t done_iterations,
             /*y=*/y
         );
         TwoWesolowskiProver prover(sg, D, weso, stop_signal);
+        prover.SetBucketThreads(GetProverBucketThreads());
         prover.GenerateProof();
 
         if (stop_signal)
@@ -388,9 +395,7 @@ Proof ProveTwoWeso(integer& D, form x, uint64_t iters, uint64_t done_iterations,
     iterations1 = iters * 2 / 3;
     iterations1 = iterations1 - iterations1 % 100;
     iterations2 = iters - iterations1;
-    while (!stop_signal && weso->iterations < done_iterations + iterations1) {
-        std::this_thread::sleep_for (std::chrono::milliseconds(100));
-    }
+    weso->WaitForIterations(done_iterations + iterations1, stop_signal);
     if (stop_signal)
         return Proof();
 
@@ -402,12 +407,11 @@ Proof ProveTwoWeso(integer& D, form x, uint64_t iters, uint64_t done_iterations,
         /*y=*/y1
     );
     TwoWesolowskiProver prover(sg, D, weso, stop_signal);
+    prover.SetBucketThreads(GetProverBucketThreads());
     prover.start();
     Proof proof2 = ProveTwoWeso(D, y1, iterations2, done_iterations + iterations1, weso, depth + 1, stop_signal);
 
-    while (!stop_signal && !prover.IsFinished()) {
-        std::this_thread::sleep_for (std::chrono::milliseconds(100));
-    }
+    prover.WaitForFinish(stop_signal);
     if (stop_signal) {
         prover.stop();
         return Proof();
@@ -444,28 +448,127 @@ class ProverManager {
         this->fast_storage = fast_storage;
         std::vector<Segment> tmp;
         for (int i = 0; i < segment_count; i++) {
-            pending_segments.push_back(tmp);
             done_segments.push_back(tmp);
             last_appended.push_back(0);
         }
     }
 
     void start() {
+        if (pool == nullptr) {
+            owned_pool.reset(new ProverPool(ProverPool::GetThreadCount(max_proving_threads)));
+            pool = owned_pool.get();
+        }
         main_loop.emplace(&ProverManager::RunEventLoop, this);
     }
 
-    void stop() {
+    // Runs the segment provers on a pool shared with other sessions instead
+    // of an own one; call before start(). The pool must outlive stop().
+    void SetProverPool(ProverPool* shared_pool) {
+        pool = shared_pool;
+    }
+
+    // Finished segment proofs are appended to store; call before start().
+    void SetCheckpointStore(CheckpointStore* store) {
+        checkpoint_store = store;
+    }
+
+    // Picks the iteration an interrupted session can resume squaring from:
+    // the end of the run of proven 2^16 segments, since later segments need
+    // their intermediates recomputed anyway. Always a multiple of 2^16 with a
+    // stored checkpoint.
+    static uint64_t GetResumeIteration(const CheckpointState& state) {
+        if (state.checkpoints.empty())
+            return 0;
+        uint64_t resume = 0;
+        if (!state.segment_proofs.empty()) {
+            std::set<uint64_t> starts;
+            for (const auto& sg : state.segment_proofs[0])
+                starts.insert(sg.first);
+            while (starts.count(resume))
+                resume += (1 << 16);
+        }
+        return std::min<uint64_t>(resume, (state.checkpoints.size() - 1) << 16);
+    }
+
+    // Restores an interrupted session; call before start() and before the
+    // VDF loop starts. Reloads, per bucket, the contiguous run of segment
+    // proofs from 0, verifying each against the stored checkpoints so a
+    // damaged record is proven again instead of being published. The
+    // unproven segments of each bucket are handed to the pool from the end
+    // of its run on; the intermediates of their part before the resume point
+    // are recomputed from the checkpoints first, on the FastStorage workers
+    // or here when there are none. Returns the iteration to resume squaring
+    // from: resume_iteration, or less if a 2^16 segment before it failed
+    // verification or a bucket's unproven segments would not fit the
+    // intermediates window.
+    uint64_t Resume(const CheckpointState& state, uint64_t resume_iteration) {
+        std::vector<uint64_t> run_end(segment_count, 0);
         {
-            std::lock_guard<std::mutex> lk(new_event_mutex);
-            stopped = true;
-            new_event = true;
+            std::lock_guard<std::mutex> lk(proof_mutex);
+            for (int i = 0; i < segment_count && i < (int)state.segment_proofs.size(); i++) {
+                uint64_t sg_length = 1ULL << (16 + 2 * i);
+                std::map<uint64_t, form> proofs(state.segment_proofs[i].begin(), state.segment_proofs[i].end());
+                // Keep the contiguous run from 0; Prove() can only chain those.
+                uint64_t start = 0;
+                auto it = proofs.find(start);
+                while (it != proofs.end() && start + sg_length <= resume_iteration &&
+                       ((start + sg_length) >> 16) < state.checkpoints.size()) {
+                    form x = state.checkpoints[start >> 16];
+                    form y = state.checkpoints[(start + sg_length) >> 16];
+                    Segment sg(start, sg_length, x, y);
+                    sg.proof = it->second;
+                    if (!IsSegmentProofValid(sg))
+                        break;
+                    done_segments[i].push_back(sg);
+                    start += sg_length;
+                    it = proofs.find(start);
+                }
+                run_end[i] = start;
+                // Later iterations need the intermediates of the broken segment.
+                if (i == 0)
+                    resume_iteration = std::min(resume_iteration, start);
+            }
+            // Recomputed intermediates share the ring of kWindowSize segments
+            // per bucket with the ones the VDF loop stores next.
+            for (int i = 1; i < segment_count; i++) {
+                uint64_t sg_length = 1ULL << (16 + 2 * i);
+                resume_iteration = std::min(resume_iteration, run_end[i] + (kWindowSize / 2) * sg_length);
+            }
+            for (int i = 0; i < segment_count; i++)
+                last_appended[i] = run_end[i];
+            vdf_iteration = resume_iteration;
         }
-        new_event_cv.notify_all();
+        if (resume_iteration == 0)
+            return 0;
+
+        weso->Resume(state, resume_iteration);
+        // Bucket i needs the intermediates from intermediates_begin[i] on.
+        std::vector<uint64_t> intermediates_begin(segment_count);
+        for (int i = 0; i < segment_count; i++)
+            intermediates_begin[i] = std::min(run_end[i], resume_iteration);
+        if (fast_storage != NULL) {
+            fast_storage->ResumeAt(resume_iteration, state.checkpoints, intermediates_begin);
+        } else {
+            RecomputeIntermediates(state, resume_iteration, intermediates_begin);
+        }
+        return resume_iteration;
+    }
+
+    void stop() {
+        stopped = true;
+        weso->NotifyEvent();
         main_loop->join();
         std::cout << "Prover event loop finished.\n" << std::flush;
 
+        std::vector<InterruptableProver*> stopped_provers;
         for (int i = 0; i < provers.size(); i++) {
             provers[i].first->stop();
+            stopped_provers.push_back(provers[i].first.get());
+        }
+        if (owned_pool != nullptr) {
+            owned_pool->Stop();
+        } else if (pool != nullptr) {
+            pool->Cancel(stopped_provers);
         }
         std::cout << "Segment provers finished.\n" << std::flush;
 
@@ -502,7 +605,7 @@ class ProverManager {
         if (iteration % (1 << 16)) {
             // Recalculate everything from the checkpoint, since there is no guarantee the iter didn't arrive late.
             integer L = root(-D, 4);
-            PulmarkReducer reducer;
+            PulmarkReducer& reducer = GetThreadPulmarkReducer();
             std::unique_ptr<form[]> intermediates(new form[(iteration % (1 << 16)) / 10 + 100]);
             for (int i = 0; i < iteration % (1 << 16); i++) {
                 if (i % 10 == 0) {
@@ -521,6 +624,7 @@ class ProverManager {
                 /*y=*/y
             );
             OneWesolowskiProver prover(sg, D, intermediates.get(), stopped);
+            prover.SetBucketThreads(GetProverBucketThreads());
             prover.start();
             sg.proof = prover.GetProof();
             if (stopped) {
@@ -539,11 +643,13 @@ class ProverManager {
             });
             if (stopped)
                 return Proof();
+            uint64_t seen_segments_version = done_segments_version;
             int blobs = 0;
             for (int i = segment_count - 1; i >= 0; i--) {
                 uint64_t segment_size = (1LL << (16 + 2 * i));
                 uint64_t position = proved_iters / segment_size;
-                while (position < done_segments[i].size() && proved_iters + segment_size <= iteration) {
+                while (position < done_segments[i].size() && !done_segments[i][position].is_empty &&
+                       proved_iters + segment_size <= iteration) {
                     proof_segments.emplace_back(done_segments[i][position]);
                     position++;
                     proved_iters += segment_size;
@@ -553,14 +659,14 @@ class ProverManager {
             pending_iters.erase(iteration);
             lk.unlock();
             if (blobs > 63 || proved_iters < iteration - iteration % (1 << 16)) {
-                std::cout << "Warning: Insufficient segments yet. Retrying in 1 minute\n";
+                std::cout << "Warning: Insufficient segments yet. Retrying when more segments are done\n";
                 proof_segments.clear();
                 proved_iters = 0;
-                this_thread::sleep_for(60s);
-                {
-                    std::lock_guard<std::mutex> lkg(proof_mutex);
-                    pending_iters.insert(iteration);
-                }
+                lk.lock();
+                pending_iters.insert(iteration);
+                proof_cv.wait(lk, [this, seen_segments_version] {
+                    return done_segments_version != seen_segments_version || stopped.load();
+                });
             } else {
                 valid_proof = true;
             }
@@ -606,12 +712,7 @@ class ProverManager {
         bool increased_proving = false;
         while (!stopped) {
             // Wait for some event to happen.
-            {
-                std::unique_lock<std::mutex> lk(new_event_mutex);
-                new_event_cv.wait(lk, []{return new_event;});
-                new_event = false;
-                lk.unlock();
-            }
+            weso->WaitForEvent();
             if (stopped)
                 return;
             // Check if we can prove the last segment for some iteration.
@@ -621,6 +722,7 @@ class ProverManager {
                 if (!increased_proving && multi_proc_machine) {
                     std::cout << "Warning: VDF running longer than (expected) 5 minutes. Adding 2 more proving threads.\n";
                     max_proving_threads += 2;
+                    pool->SetThreads(ProverPool::GetThreadCount(max_proving_threads));
                     increased_proving = true;
                 }
             }
@@ -635,13 +737,15 @@ class ProverManager {
                 last_segment_cv.notify_all();
             }
             uint64_t best_pending_iter = (1LL << 63);
+            bool new_done_segment = false;
             {
                 // Protect done_segments, pending_iters and max_proving_iters.
                 std::lock_guard<std::mutex> lk(proof_mutex);
                 bool new_small_segment = false;
                 // Check if some provers finished.
                 for (int i = 0; i < provers.size(); i++) {
-                    if (provers[i].first->IsFinished()) {
+                    // Fully finished: the pool is done with it.
+                    if (provers[i].first->IsFullyFinished()) {
                         provers[i].second.proof = provers[i].first->GetProof();
                         if (debug_mode) {
                             std::cout << "Done segment: [" << provers[i].second.start
@@ -656,10 +760,14 @@ class ProverManager {
                         while (done_segments[index].size() <= position)
                             done_segments[index].emplace_back(Segment());
                         done_segments[index][position] = provers[i].second;
-                        if (provers[i].first->IsFullyFinished()) {
-                            provers.erase(provers.begin() + i);
-                            i--;
+                        done_segments_version++;
+                        new_done_segment = true;
+                        if (checkpoint_store != nullptr) {
+                            checkpoint_store->AppendSegmentProof(index, provers[i].second.start,
+                                                                 provers[i].second.proof);
                         }
+                        provers.erase(provers.begin() + i);
+                        i--;
                     }
                 }
 
@@ -698,8 +806,9 @@ class ProverManager {
                     }
                 }
             }
-            // We have all the proof for some iter, except for the small segment.
-            if (max_proving_iteration >= best_pending_iter - best_pending_iter % (1 << 16)) {
+            // We have all the proof for some iter, except for the small segment,
+            // or a Prove() call waiting for more segments can retry.
+            if (new_done_segment || max_proving_iteration >= best_pending_iter - best_pending_iter % (1 << 16)) {
                 proof_cv.notify_all();
             }
 
@@ -709,7 +818,7 @@ class ProverManager {
                 intermediates_iter = vdf_iteration;
             }
 
-            // Check if new segments have arrived, and add them as pending proof.
+            // Check if new segments have arrived, and hand them to the pool.
             for (int i = 0; i < segment_count; i++) {
                 uint64_t sg_length = 1LL << (16 + 2 * i);
                 while (last_appended[i] + sg_length <= intermediates_iter) {
@@ -720,94 +829,79 @@ class ProverManager {
                         /*x=*/weso->checkpoints[last_appended[i] / (1 << 16)],
                         /*y=*/weso->checkpoints[(last_appended[i] + sg_length) / (1 << 16)]
                     );
-                    pending_segments[i].emplace_back(sg);
-                    if (!warned && pending_segments[i].size() >= kWindowSize - 2) {
-                        warned = true;
-                        std::cout << "Warning: VDF loop way ahead of proving loop. "
-                                  << "Possible proof corruption. Please increase kWindowSize.\n";
-                    }
+                    provers.emplace_back(
+                        std::make_pair(
+                            std::make_unique<InterruptableProver>(sg, D, weso),
+                            sg
+                        )
+                    );
+                    provers[provers.size() - 1].first->SetBucketThreads(GetProverBucketThreads());
+                    pool->Submit(provers[provers.size() - 1].first.get());
                     last_appended[i] += sg_length;
                 }
             }
-            // If we have free proving threads, use them first.
-            int active_provers = 0;
-            for (int i = 0; i < provers.size(); i++) {
-                if (provers[i].first->IsRunning())
-                    active_provers++;
-            }
-
-            while (!stopped) {
-                // Find the best pending/paused segment and remember where it is.
-                Segment best;
-                int index;
-                bool new_segment;
+            if (!warned) {
+                // Segments not started yet, per bucket.
+                std::vector<int> waiting(segment_count, 0);
                 for (int i = 0; i < provers.size(); i++) {
-                    if (!provers[i].first->IsRunning()) {
-                        if (best.IsWorseThan(provers[i].second)) {
-                            best = provers[i].second;
-                            index = i;
-                            new_segment = false;
-                        }
-                    }
+                    if (!provers[i].first->HasStarted() && !provers[i].first->IsFullyFinished())
+                        waiting[provers[i].second.GetSegmentBucket()]++;
                 }
                 for (int i = 0; i < segment_count; i++) {
-                    if (pending_segments[i].size() > 0) {
-                        if (best.IsWorseThan(pending_segments[i][0])) {
-                            best = pending_segments[i][0];
-                            index = i;
-                            new_segment = true;
-                        }
+                    if (waiting[i] >= kWindowSize - 2) {
+                        warned = true;
+                        std::cout << "Warning: VDF loop way ahead of proving loop. "
+                                  << "Possible proof corruption. Please increase kWindowSize.\n";
+                        break;
                     }
                 }
-                // If nothing to run, stop.
-                if (best.is_empty)
-                    break;
-                bool spawn_best = false;
-                // If we have free threads, use them.
-                if (active_provers < max_proving_threads) {
-                    spawn_best = true;
-                    active_provers++;
-                } else {
-                    // Otherwise, pause one already running segment, if candidate is better.
-                    Segment worst_running;
-                    int worst_index;
-                    for (int i = 0; i < provers.size(); i++)
-                        if (provers[i].first->IsRunning()) {
-                            if (worst_running.is_empty == true || provers[i].second.IsWorseThan(worst_running)) {
-                                worst_running = provers[i].second;
-                                worst_index = i;
-                            }
+            }
+        }
+    }
+
+  private:
+    // Recomputes the intermediates before resume_iteration that the buckets
+    // need, one 2^16 block per task on all cores, since the VDF loop waits.
+    void RecomputeIntermediates(const CheckpointState& state, uint64_t resume_iteration,
+                                const std::vector<uint64_t>& intermediates_begin) {
+        uint64_t begin = *std::min_element(intermediates_begin.begin(), intermediates_begin.end());
+        std::atomic<uint64_t> next_block(begin);
+        auto worker = [&] {
+            PulmarkReducer& reducer = GetThreadPulmarkReducer();
+            integer& L = weso->L;
+            uint64_t block;
+            while ((block = next_block.fetch_add(1 << 16)) < resume_iteration) {
+                form y = state.checkpoints[block >> 16];
+                for (uint64_t iteration = block; iteration < block + (1 << 16); iteration++) {
+                    for (int i = 0; i < segment_count; i++) {
+                        uint64_t power_2 = 1LL << (16 + 2 * i);
+                        int kl = (i == 0) ? 10 : (12 * (power_2 >> 18));
+                        if (iteration >= intermediates_begin[i] && (iteration % power_2) % kl == 0) {
+                            weso->SetIntermediate(iteration, i, y);
                         }
-                    // If the candidate is better than worst running, stop worst running and spawn candidate.
-                    if (worst_running.IsWorseThan(best)) {
-                        spawn_best = true;
-                        provers[worst_index].first->pause();
-                    }
-                }
-                // Best provers are already running, nothing will change until a new event happens.
-                if (!spawn_best) {
-                    break;
-                }
-                // Spawn the best segment.
-                if (!new_segment) {
-                    provers[index].first->resume();
-                } else {
-                    if (!stopped) {
-                        provers.emplace_back(
-                            std::make_pair(
-                                std::make_unique<InterruptableProver>(best, D, weso),
-                                best
-                            )
-                        );
-                        provers[provers.size() - 1].first->start();
-                        pending_segments[index].erase(pending_segments[index].begin());
                     }
+                    nudupl_form(y, y, D, L);
+                    reducer.reduce(y);
                 }
             }
-        }
+        };
+        int threads = std::max(1, (int)std::min<uint64_t>(std::thread::hardware_concurrency(),
+                                                           (resume_iteration - begin) >> 16));
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; t++)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& w : workers)
+            w.join();
+    }
+
+    // Checks a segment proof reloaded from disk, far cheaper than proving it.
+    bool IsSegmentProofValid(Segment& sg) {
+        integer B = GetB(D, sg.x, sg.y);
+        form out_y;
+        return VerifyWesoSegment(D, sg.x, sg.proof, B, sg.length, out_y) == 0 && out_y == sg.y;
     }
 
-  private:
     std::atomic<bool> stopped = false;
     int segment_count;
     // Maximum amount of proving threads running at once.
@@ -815,16 +909,21 @@ class ProverManager {
     std::optional<std::thread> main_loop;
     FastAlgorithmCallback* weso;
     FastStorage* fast_storage;
+    CheckpointStore* checkpoint_store = nullptr;
     // The discriminant used.
     integer D;
-    // Active or paused provers currently running.
+    // Provers that are queued, running or yielded in the pool.
     std::vector<std::pair<std::unique_ptr<InterruptableProver>, Segment>> provers;
-    // Vectors of segments needing proving, for each segment length.
-    std::vector<std::vector<Segment>> pending_segments;
+    // Runs the provers; declared after them so it is destroyed first.
+    std::unique_ptr<ProverPool> owned_pool;
+    // owned_pool, or a pool shared with other sessions.
+    ProverPool* pool = nullptr;
     // For each segment length, remember the endpoint of the last segment marked as pending.
     std::vector<uint64_t> last_appended;
     // Finished segments.
     std::vector<std::vector<Segment>> done_segments;
+    // Bumped whenever done_segments gains a segment.
+    uint64_t done_segments_version = 0;
     // Iterations that we need proof for.
     std::set<uint64_t> pending_iters;
     // Last segment beginning for our pending iters.
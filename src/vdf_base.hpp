@@ -222,19 +222,23 @@ class PulmarkReducer {
         delete(t);
     }
 
+    // Swaps the form's limbs into the context and back instead of copying,
+    // so the reduction works in place on f's own buffers.
     void reduce(form &f) {
-        mpz_set(t->a, f.a.impl);
-        mpz_set(t->b, f.b.impl);
-        mpz_set(t->c, f.c.impl);
+        mpz_swap(t->a, f.a.impl);
+        mpz_swap(t->b, f.b.impl);
+        mpz_swap(t->c, f.c.impl);
 
         reducer->run();
 
-        mpz_set(f.a.impl, t->a);
-        mpz_set(f.b.impl, t->b);
-        mpz_set(f.c.impl, t->c);
+        mpz_swap(f.a.impl, t->a);
+        mpz_swap(f.b.impl, t->b);
+        mpz_swap(f.c.impl, t->c);
     }
 };
 
+PulmarkReducer& GetThreadPulmarkReducer();
+
 struct Segment {
     uint64_t start;
     uint64_t length;
@@ -25,7 +25,7 @@
 
 static void usage(const char *progname)
 {
-    fprintf(stderr, "Usage: %s {square_asm|square|discr} N\n", progname);
+    fprintf(stderr, "Usage: %s {square_asm|square|discr|hashprime|primetest|weso|weso_twochain|reduce|blocks|blocks_powm} N\n", progname);
 }
 
 int main(int argc, char **argv)
@@ -51,6 +51,7 @@ int main(int argc, char **argv)
     int i, n_slow = 0;
     PulmarkReducer reducer;
     bool is_comp = true, is_asm = false;
+    const char *op_name = "discr";
 
 
     auto t1 = std::chrono::high_resolution_clock::now();
@@ -108,6 +109,126 @@ int main(int argc, char **argv)
             ch_vec[i % CH_SIZE] += 1;
             integer discr = CreateDiscriminant(ch_vec, 1024);
         }
+    } else if (!strcmp(argv[1], "hashprime")) {
+        // The HashPrime search of "discr", with its candidate counts.
+        std::vector<uint8_t> ch_vec(CH_SIZE);
+        uint64_t candidates = 0, rejects = 0, tests = 0;
+
+        is_comp = false;
+        op_name = "prime";
+        for (i = 0; i < iters; i++) {
+            HashPrimeStats stats;
+            ch_vec[i % CH_SIZE] += 1;
+            HashPrime(ch_vec, 1024, {0, 1, 2, 1023}, &stats);
+            candidates += stats.candidates;
+            rejects += stats.small_factor_rejects;
+            tests += stats.probable_prime_tests;
+        }
+        printf("candidates/prime: %.1f; trial division rejects: %.1f%%; MR+Lucas tests/prime: %.1f\n",
+               (double)candidates / iters, 100.0 * rejects / candidates, (double)tests / iters);
+    } else if (!strcmp(argv[1], "primetest")) {
+        // Miller-Rabin and Lucas on random 1024-bit candidates without small
+        // factors, against the mpz implementation; fails on any mismatch.
+        gmp_randstate_t state;
+        std::vector<integer> candidates;
+        int mismatches = 0;
+
+        is_comp = false;
+        op_name = "test";
+        gmp_randinit_default(state);
+        while ((int)candidates.size() < iters) {
+            integer n;
+            mpz_urandomb(n.impl, state, 1024);
+            mpz_setbit(n.impl, 1023);
+            mpz_setbit(n.impl, 0);
+            if (!has_small_factor(n.impl, bpsw_pprods_count(n.impl)))
+                candidates.push_back(n);
+        }
+        gmp_randclear(state);
+
+        std::vector<int> expected(candidates.size());
+        auto gmp_start = std::chrono::high_resolution_clock::now();
+        for (size_t j = 0; j < candidates.size(); j++)
+            expected[j] = is_bpsw_probable_prime_gmp(candidates[j].impl);
+        int gmp_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - gmp_start).count();
+        t1 = std::chrono::high_resolution_clock::now();
+        for (size_t j = 0; j < candidates.size(); j++)
+            mismatches += is_bpsw_probable_prime(candidates[j].impl) != expected[j];
+        printf("mpz implementation: %d ms; mismatches: %d\n", gmp_ms, mismatches);
+        if (mismatches)
+            return 1;
+    } else if (!strcmp(argv[1], "weso") || !strcmp(argv[1], "weso_twochain")) {
+        // Core of a Wesolowski verification: proof^B * x^r with a 264-bit B.
+        // "weso" shares the squarings between both bases, "weso_twochain"
+        // runs two separate exponentiations and composes the results.
+        bool is_multi = !strcmp(argv[1], "weso");
+        form proof = FastPowFormNucomp(y, D, integer(123456789), L, reducer);
+        integer B = HashPrime({1, 2, 3}, B_bits, {B_bits - 1});
+        integer r = FastPow(2, 1000000, B);
+        form out;
+
+        is_comp = false;
+        op_name = "verify";
+        t1 = std::chrono::high_resolution_clock::now();
+        for (i = 0; i < iters; i++) {
+            if (is_multi) {
+                out = FastMultiPowFormNucomp({proof, y}, {B, r}, D, L, reducer);
+            } else {
+                out = FastPowFormNucomp(proof, D, B, L, reducer) *
+                      FastPowFormNucomp(y, D, r, L, reducer);
+            }
+        }
+        out.reduce();
+        printf("a = %s\n", out.a.to_string().c_str());
+    } else if (!strcmp(argv[1], "reduce")) {
+        // Pulmark reduction of a form left unreduced by a few NUDUPLs.
+        form unreduced = y;
+        for (i = 0; i < 200; i++) {
+            nudupl_form(unreduced, unreduced, D, L);
+            reducer.reduce(unreduced);
+        }
+        // Shear by a large multiple so the reducer has real work to do.
+        integer k("0x1234567890abcdef1234567890abcdef");
+        unreduced.b = unreduced.b + integer(2) * unreduced.a * k;
+        unreduced.c = (unreduced.b * unreduced.b - D) / (integer(4) * unreduced.a);
+        form f;
+
+        is_comp = false;
+        op_name = "reduce";
+        t1 = std::chrono::high_resolution_clock::now();
+        for (i = 0; i < iters; i++) {
+            f = unreduced;
+            reducer.reduce(f);
+        }
+        printf("a = %s\n", f.a.to_string().c_str());
+    } else if (!strcmp(argv[1], "blocks") || !strcmp(argv[1], "blocks_powm")) {
+        // Proof digits of one prover pass over a 2^30 segment (k = 12, l = 10).
+        // "blocks" steps a running remainder, "blocks_powm" does one modular
+        // exponentiation per digit like GetBlock.
+        const uint64_t k = 12, l = 10, T = uint64_t(1) << 30;
+        bool is_stream = !strcmp(argv[1], "blocks");
+        integer B = HashPrime({1, 2, 3}, B_bits, {B_bits - 1});
+        uint64_t count = std::min<uint64_t>(iters, NumBlocksInPass(0, k, l, T));
+        uint64_t sum = 0;
+
+        is_comp = false;
+        op_name = "digit";
+        t1 = std::chrono::high_resolution_clock::now();
+        if (is_stream) {
+            BlockDigitStream digits(0, l, k, T, B);
+            for (uint64_t n = 0; n < count; n++)
+                sum += digits.Next();
+        } else {
+            for (uint64_t n = 0; n < count; n++) {
+                integer res = FastPow(2, T - k * (n * l + 1), B);
+                mpz_mul_2exp(res.impl, res.impl, k);
+                mpz_tdiv_q(res.impl, res.impl, B.impl);
+                sum += mpz_getlimbn(res.impl, 0);
+            }
+        }
+        iters = static_cast<int>(count);
+        printf("digit sum = %llu\n", (unsigned long long)sum);
     } else {
         fprintf(stderr, "Unknown command\n");
         usage(argv[0]);
@@ -133,7 +254,10 @@ int main(int argc, char **argv)
         printf("b = %s\n", y.b.to_string().c_str());
         printf("c = %s\n", y.c.to_string().c_str());
     } else {
-        printf("speed: %d.%d ms/discr\n", duration/iters, duration*10/iters % 10);
+        if (iters >= duration)
+            printf("speed: %d.%dK %ss/s\n", iters/duration, iters*10/duration % 10, op_name);
+        else
+            printf("speed: %d.%d ms/%s\n", duration/iters, duration*10/iters % 10, op_name);
     }
     return 0;
 }
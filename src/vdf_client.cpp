@@ -6,7 +6,6 @@
 
 using boost::asio::ip::tcp;
 
-std::mutex socket_mutex;
 namespace {
 constexpr int kIterationHeaderDigits = 2;
 constexpr int kMaxIterationDigits = 20;
@@ -22,7 +21,22 @@ void PrintInfo(std::string input) {
     std::cout << std::flush;
 }
 
-void WriteProof(uint64_t iteration, Proof& result, tcp::socket& sock) {
+// One connection from a timelord. In server mode several sessions run in
+// one process, so everything a session changes lives here or is owned by
+// its Session* function.
+struct VdfSession {
+    explicit VdfSession(tcp::socket socket) : sock(std::move(socket)) {}
+
+    tcp::socket sock;
+    // Serializes proof writes from the prover threads.
+    std::mutex socket_mutex;
+    SessionChallenge challenge;
+    // Segment prover pool shared by the sessions of a server, or nullptr
+    // for one of the session's own.
+    ProverPool* prover_pool = nullptr;
+};
+
+void WriteProof(uint64_t iteration, Proof& result, VdfSession& session) {
     // Writes the number of iterations
     uint8_t int_bytes[8];
     std::vector<uint8_t> bytes;
@@ -44,38 +58,38 @@ void WriteProof(uint64_t iteration, Proof& result, tcp::socket& sock) {
 
     PrintInfo("Sending proof");
     {
-        std::lock_guard<std::mutex> lock(socket_mutex);
-        boost::asio::write(sock, boost::asio::buffer(int_bytes, 4));
-        boost::asio::write(sock, boost::asio::buffer(str_result.c_str(), str_result.size()));
+        std::lock_guard<std::mutex> lock(session.socket_mutex);
+        boost::asio::write(session.sock, boost::asio::buffer(int_bytes, 4));
+        boost::asio::write(session.sock, boost::asio::buffer(str_result.c_str(), str_result.size()));
     }
     PrintInfo("Sent proof");
 }
 
-void CreateAndWriteProof(ProverManager& pm, uint64_t iteration, std::atomic<bool>& stop_signal, tcp::socket& sock) {
+void CreateAndWriteProof(ProverManager& pm, uint64_t iteration, std::atomic<bool>& stop_signal, VdfSession& session) {
     Proof result = pm.Prove(iteration);
     if (stop_signal == true) {
         PrintInfo("Got stop signal before completing the proof!");
         return ;
     }
-    WriteProof(iteration, result, sock);
+    WriteProof(iteration, result, session);
 }
 
-void CreateAndWriteProofOneWeso(uint64_t iters, integer& D, form f, OneWesolowskiCallback* weso, std::atomic<bool>& stop_signal, tcp::socket& sock) {
+void CreateAndWriteProofOneWeso(uint64_t iters, integer& D, form f, OneWesolowskiCallback* weso, std::atomic<bool>& stop_signal, VdfSession& session) {
     Proof result = ProveOneWesolowski(iters, D, f, weso, stop_signal);
     if (stop_signal) {
         PrintInfo("Got stop signal before completing the proof!");
         return ;
     }
-    WriteProof(iters, result, sock);
+    WriteProof(iters, result, session);
 }
 
-void CreateAndWriteProofTwoWeso(integer& D, form f, uint64_t iters, TwoWesolowskiCallback* weso, std::atomic<bool>& stop_signal, tcp::socket& sock) {
+void CreateAndWriteProofTwoWeso(integer& D, form f, uint64_t iters, TwoWesolowskiCallback* weso, std::atomic<bool>& stop_signal, VdfSession& session) {
     Proof result = ProveTwoWeso(D, f, iters, 0, weso, 0, stop_signal);
     if (stop_signal) {
         PrintInfo("Got stop signal before completing the proof!");
         return ;
     }
-    WriteProof(iters, result, sock);
+    WriteProof(iters, result, session);
 }
 
 void ConfigureSessionRuntime() {
@@ -92,19 +106,19 @@ void ConfigureSessionRuntime() {
     set_rounding_mode();
 }
 
-void FinishSession(tcp::socket& sock) {
+void FinishSession(VdfSession& session) {
     try {
         // Tell client I've stopped everything, wait for ACK and close.
         boost::system::error_code error;
 
         PrintInfo("Stopped everything! Ready for the next challenge.");
 
-        std::lock_guard<std::mutex> lock(socket_mutex);
-        boost::asio::write(sock, boost::asio::buffer("STOP", 4));
+        std::lock_guard<std::mutex> lock(session.socket_mutex);
+        boost::asio::write(session.sock, boost::asio::buffer("STOP", 4));
 
         char ack[5];
         memset(ack, 0x00, sizeof(ack));
-        boost::asio::read(sock, boost::asio::buffer(ack, 3), error);
+        boost::asio::read(session.sock, boost::asio::buffer(ack, 3), error);
         if (strncmp(ack, "ACK", 3) != 0) {
             throw std::runtime_error("Invalid stop ACK");
         }
@@ -153,14 +167,14 @@ uint64_t ReadIteration(tcp::socket& sock) {
     return iters;
 }
 
-void SessionFastAlgorithm(tcp::socket& sock) {
-    InitSession(sock);
+void SessionFastAlgorithm(VdfSession& session) {
+    InitSession(session.sock, session.challenge);
     ConfigureSessionRuntime();
     try {
-        integer D(disc);
+        integer D(session.challenge.disc);
         integer L = root(-D, 4);
         PrintInfo("Discriminant = " + to_string(D.impl));
-        form f = DeserializeForm(D, initial_form_s, sizeof(initial_form_s));
+        form f = DeserializeForm(D, session.challenge.initial_form_s, sizeof(session.challenge.initial_form_s));
         PrintInfo("Initial form: " + to_string(f.a.impl) + " " + to_string(f.b.impl));
         std::vector<std::thread> threads;
         const bool multi_proc_machine = (std::thread::hardware_concurrency() >= 16) ? true : false;
@@ -170,15 +184,46 @@ void SessionFastAlgorithm(tcp::socket& sock) {
             fast_storage = new FastStorage((FastAlgorithmCallback*)weso);
         }
         std::atomic<bool> stopped(false);
-        std::thread vdf_worker(repeated_square, 0, f, std::ref(D), std::ref(L), weso, fast_storage, std::ref(stopped));
         ProverManager pm(D, (FastAlgorithmCallback*)weso, fast_storage, segments, thread_count);
+        if (session.prover_pool != nullptr) {
+            pm.SetProverPool(session.prover_pool);
+        }
+
+        // With CHIAVDF_CHECKPOINT_DIR set, the session is logged to disk and
+        // an interrupted session for the same challenge is resumed.
+        std::unique_ptr<CheckpointStore> checkpoint_store;
+        uint64_t resume_iteration = 0;
+        form start_form = f;
+        const char* checkpoint_dir = getenv(kCheckpointDirEnv);
+        if (checkpoint_dir != nullptr && checkpoint_dir[0] != '\0') {
+            try {
+                checkpoint_store.reset(new CheckpointStore(GetCheckpointStorePath(checkpoint_dir, D, f), D, f));
+            } catch (std::exception& e) {
+                PrintInfo("Checkpoint store disabled: " + to_string(e.what()));
+            }
+        }
+        if (checkpoint_store) {
+            const CheckpointState& state = checkpoint_store->GetState();
+            resume_iteration = ProverManager::GetResumeIteration(state);
+            if (resume_iteration > 0) {
+                resume_iteration = pm.Resume(state, resume_iteration);
+            }
+            if (resume_iteration > 0) {
+                PrintInfo("Resuming session at iteration " + to_string(resume_iteration));
+                start_form = state.checkpoints[resume_iteration / (1 << 16)];
+            }
+            ((FastAlgorithmCallback*)weso)->checkpoint_store = checkpoint_store.get();
+            pm.SetCheckpointStore(checkpoint_store.get());
+        }
+
+        std::thread vdf_worker(repeated_square_from, resume_iteration, 0, start_form, std::ref(D), std::ref(L), weso, fast_storage, std::ref(stopped));
         pm.start();
 
         // Tell client that I'm ready to get the challenges.
-        boost::asio::write(sock, boost::asio::buffer("OK", 2));
+        boost::asio::write(session.sock, boost::asio::buffer("OK", 2));
 
         while (!stopped) {
-            uint64_t iters = ReadIteration(sock);
+            uint64_t iters = ReadIteration(session.sock);
             if (iters == 0) {
                 PrintInfo("Got stop signal!");
                 stopped = true;
@@ -193,40 +238,40 @@ void SessionFastAlgorithm(tcp::socket& sock) {
                 delete(weso);
             } else {
                 PrintInfo("Received iteration: " + to_string(iters));
-                threads.push_back(std::thread(CreateAndWriteProof, std::ref(pm), iters, std::ref(stopped), std::ref(sock)));
+                threads.push_back(std::thread(CreateAndWriteProof, std::ref(pm), iters, std::ref(stopped), std::ref(session)));
             }
         }
     } catch (std::exception& e) {
         PrintInfo("Exception in thread: " + to_string(e.what()));
     }
-    FinishSession(sock);
+    FinishSession(session);
 }
 
-void SessionOneWeso(tcp::socket& sock) {
-    InitSession(sock);
+void SessionOneWeso(VdfSession& session) {
+    InitSession(session.sock, session.challenge);
     ConfigureSessionRuntime();
     try {
-        integer D(disc);
+        integer D(session.challenge.disc);
         integer L = root(-D, 4);
         PrintInfo("Discriminant = " + to_string(D.impl));
-        form f = DeserializeForm(D, initial_form_s, sizeof(initial_form_s));
+        form f = DeserializeForm(D, session.challenge.initial_form_s, sizeof(session.challenge.initial_form_s));
         // Tell client that I'm ready to get the challenges.
-        boost::asio::write(sock, boost::asio::buffer("OK", 2));
+        boost::asio::write(session.sock, boost::asio::buffer("OK", 2));
 
-        uint64_t iter = ReadIteration(sock);
+        uint64_t iter = ReadIteration(session.sock);
         if (iter == 0) {
-            FinishSession(sock);
+            FinishSession(session);
             return;
         }
         std::atomic<bool> stopped(false);
         WesolowskiCallback* weso = new OneWesolowskiCallback(D, f, iter);
         FastStorage* fast_storage = NULL;
         std::thread vdf_worker(repeated_square, iter, f, std::ref(D), std::ref(L), weso, fast_storage, std::ref(stopped));
-        std::thread th_prover(CreateAndWriteProofOneWeso, iter, std::ref(D), f, (OneWesolowskiCallback*)weso, std::ref(stopped), std::ref(sock));
-        iter = ReadIteration(sock);
+        std::thread th_prover(CreateAndWriteProofOneWeso, iter, std::ref(D), f, (OneWesolowskiCallback*)weso, std::ref(stopped), std::ref(session));
+        iter = ReadIteration(session.sock);
         while (iter != 0) {
             std::cout << "Warning: did not receive stop signal\n";
-            iter = ReadIteration(sock);
+            iter = ReadIteration(session.sock);
         }
         stopped = true;
         vdf_worker.join();
@@ -235,21 +280,21 @@ void SessionOneWeso(tcp::socket& sock) {
     } catch (std::exception& e) {
         PrintInfo("Exception in thread: " + to_string(e.what()));
     }
-    FinishSession(sock);
+    FinishSession(session);
 }
 
-void SessionTwoWeso(tcp::socket& sock) {
+void SessionTwoWeso(VdfSession& session) {
     const int kMaxProcessesAllowed = 100;
-    InitSession(sock);
+    InitSession(session.sock, session.challenge);
     ConfigureSessionRuntime();
     try {
-        integer D(disc);
+        integer D(session.challenge.disc);
         integer L = root(-D, 4);
         PrintInfo("Discriminant = " + to_string(D.impl));
-        form f = DeserializeForm(D, initial_form_s, sizeof(initial_form_s));
+        form f = DeserializeForm(D, session.challenge.initial_form_s, sizeof(session.challenge.initial_form_s));
 
         // Tell client that I'm ready to get the challenges.
-        boost::asio::write(sock, boost::asio::buffer("OK", 2));
+        boost::asio::write(session.sock, boost::asio::buffer("OK", 2));
 
         std::atomic<bool> stopped(false);
         std::atomic<bool> stop_vector[100];
@@ -261,7 +306,7 @@ void SessionTwoWeso(tcp::socket& sock) {
         std::thread vdf_worker(repeated_square, 0, f, std::ref(D), std::ref(L), weso, fast_storage, std::ref(stopped));
 
         while (!stopped) {
-            uint64_t iters = ReadIteration(sock);
+            uint64_t iters = ReadIteration(session.sock);
             if (iters == 0) {
                 PrintInfo("Got stop signal!");
                 stopped = true;
@@ -304,7 +349,7 @@ void SessionTwoWeso(tcp::socket& sock) {
                     stop_vector[threads.size()] = false;
                     threads.push_back(std::thread(CreateAndWriteProofTwoWeso, std::ref(D), f, iters,
                                       (TwoWesolowskiCallback*)weso, std::ref(stop_vector[threads.size()]),
-                                      std::ref(sock)));
+                                      std::ref(session)));
                     if (threads.size() > kMaxProcessesAllowed) {
                         PrintInfo("Stopping proving for iter: " + to_string(max_iter));
                         stop_vector[max_iter_thread_id] = true;
@@ -316,52 +361,131 @@ void SessionTwoWeso(tcp::socket& sock) {
     } catch (std::exception& e) {
         PrintInfo("Exception in thread: " + to_string(e.what()));
     }
-    FinishSession(sock);
+    FinishSession(session);
 }
 
 int gcd_base_bits = 50;
 int gcd_128_max_iter = 3;
 
+// Reads the prover type and runs the session to its end.
+void RunSession(VdfSession& session) {
+    boost::system::error_code error;
+    char prover_type_buf[5];
+    boost::asio::read(session.sock, boost::asio::buffer(prover_type_buf, 1), error);
+    if (error) {
+        PrintInfo("Could not read prover type: " + error.message());
+        return;
+    }
+    // Check for "S" (simple weso), "N" (n-weso), or "T" (2-weso)
+    if (prover_type_buf[0] == 'S') {
+        SessionOneWeso(session);
+    }
+    if (prover_type_buf[0] == 'N') {
+        SessionFastAlgorithm(session);
+    }
+    if (prover_type_buf[0] == 'T') {
+        SessionTwoWeso(session);
+    }
+}
+
+// Server mode: timelords connect to port, each connection is one session
+// with the usual protocol, and up to max_sessions run at once. The sessions
+// share the GMP and asm setup, one segment prover pool and the VDF core
+// pairs of the thread placement.
+class VdfServer {
+  public:
+    VdfServer(boost::asio::io_context& io_context, uint16_t port, int max_sessions)
+        : acceptor(io_context), max_sessions(max_sessions),
+          prover_pool(ProverPool::GetThreadCount(thread_count * max_sessions)) {
+        tcp::endpoint endpoint(tcp::v6(), port);
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(boost::asio::ip::v6_only(false));
+        acceptor.set_option(tcp::acceptor::reuse_address(true));
+        acceptor.bind(endpoint);
+        acceptor.listen();
+        PrintInfo("Listening on port " + to_string(port) + " for up to " + to_string(max_sessions) +
+                  " sessions, " + to_string(prover_pool.GetThreads()) + " proving threads");
+        Accept();
+    }
+
+  private:
+    void Accept() {
+        acceptor.async_accept([this](const boost::system::error_code& error, tcp::socket socket) {
+            if (error) {
+                PrintInfo("Accept failed: " + error.message());
+            } else if (active_sessions >= max_sessions) {
+                PrintInfo("Too many sessions, closing connection");
+                boost::system::error_code ignored;
+                socket.close(ignored);
+            } else {
+                active_sessions++;
+                auto session = std::make_shared<VdfSession>(std::move(socket));
+                session->prover_pool = &prover_pool;
+                std::thread([this, session] {
+                    try {
+                        RunSession(*session);
+                    } catch (std::exception& e) {
+                        PrintInfo("Exception in session: " + to_string(e.what()));
+                    }
+                    active_sessions--;
+                }).detach();
+            }
+            Accept();
+        });
+    }
+
+    tcp::acceptor acceptor;
+    const int max_sessions;
+    std::atomic<int> active_sessions{0};
+    ProverPool prover_pool;
+};
+
 int main(int argc, char* argv[]) try {
     init_gmp();
     if (argc == 2 && strcmp(argv[1], "--version") == 0) {
         PrintCliVersion(argv[0]);
         return 0;
     }
-    if (argc != 4) {
+    const bool server_mode = argc >= 2 && strcmp(argv[1], "--server") == 0;
+    if (server_mode ? (argc != 3 && argc != 4) : argc != 4) {
       std::cerr << "Usage: ./vdf_client <host> <port> <counter>\n";
+      std::cerr << "       ./vdf_client --server <port> [<max_sessions>]\n";
       return 1;
     }
+    int max_sessions = 1;
+    if (server_mode && argc == 4) {
+        max_sessions = atoi(argv[3]);
+        if (max_sessions < 1 || max_sessions > kMaxSquarePairs) {
+            std::cerr << "max_sessions must be between 1 and " << kMaxSquarePairs << "\n";
+            return 1;
+        }
+    }
 
     if(hasAVX2()) {
       gcd_base_bits = 63;
       gcd_128_max_iter = 2;
     }
+    std::cout << ConfigureThreadPlacement(max_sessions) << "\n" << std::flush;
 
     boost::asio::io_context io_context;
 
+    if (server_mode) {
+        int port = atoi(argv[2]);
+        if (port <= 0 || port > 65535) {
+            std::cerr << "Invalid port\n";
+            return 1;
+        }
+        VdfServer server(io_context, static_cast<uint16_t>(port), max_sessions);
+        io_context.run();
+        return 0;
+    }
+
     tcp::resolver resolver(io_context);
     tcp::resolver::results_type endpoints = resolver.resolve(tcp::v6(), argv[1], argv[2], boost::asio::ip::resolver_query_base::v4_mapped);
 
-    tcp::socket s(io_context);
-    boost::asio::connect(s, endpoints);
-    fast_algorithm = false;
-    two_weso = false;
-    boost::system::error_code error;
-    char prover_type_buf[5];
-    boost::asio::read(s, boost::asio::buffer(prover_type_buf, 1), error);
-    // Check for "S" (simple weso), "N" (n-weso), or "T" (2-weso)
-    if (prover_type_buf[0] == 'S') {
-        SessionOneWeso(s);
-    }
-    if (prover_type_buf[0] == 'N') {
-        fast_algorithm = true;
-        SessionFastAlgorithm(s);
-    }
-    if (prover_type_buf[0] == 'T') {
-        two_weso = true;
-        SessionTwoWeso(s);
-    }
+    VdfSession session{tcp::socket(io_context)};
+    boost::asio::connect(session.sock, endpoints);
+    RunSession(session);
     return 0;
 }
 catch (std::exception& e) {
@@ -8,10 +8,15 @@
 #include <stdexcept>
 #include <string>
 
-inline char disc[350];
-inline uint8_t initial_form_s[BQFC_FORM_SIZE];
+// Challenge of one vdf_client session, read by InitSession.
+struct SessionChallenge {
+    char disc[350];
+    uint8_t initial_form_s[BQFC_FORM_SIZE];
+};
 
-inline void InitSession(boost::asio::ip::tcp::socket& sock) {
+inline void InitSession(boost::asio::ip::tcp::socket& sock, SessionChallenge& challenge) {
+    char* disc = challenge.disc;
+    uint8_t* initial_form_s = challenge.initial_form_s;
     boost::system::error_code error;
     char disc_size[5];
     int disc_int_size;
@@ -23,13 +28,13 @@ inline void InitSession(boost::asio::ip::tcp::socket& sock) {
         }
     };
 
-    memset(disc, 0x00, sizeof(disc)); // For null termination
+    memset(disc, 0x00, sizeof(challenge.disc)); // For null termination
     memset(disc_size, 0x00, sizeof(disc_size)); // For null termination
 
     boost::asio::read(sock, boost::asio::buffer(disc_size, 3), error);
     check_read_error("discriminant size");
     disc_int_size = atoi(disc_size);
-    if (disc_int_size <= 0 || disc_int_size >= (int)sizeof(disc)) {
+    if (disc_int_size <= 0 || disc_int_size >= (int)sizeof(challenge.disc)) {
         throw std::runtime_error("Invalid discriminant size");
     }
     boost::asio::read(sock, boost::asio::buffer(disc, disc_int_size), error);
@@ -39,7 +44,7 @@ inline void InitSession(boost::asio::ip::tcp::socket& sock) {
     char form_size;
     boost::asio::read(sock, boost::asio::buffer(&form_size, 1), error);
     check_read_error("form size");
-    if (form_size <= 0 || form_size > (int)sizeof(initial_form_s)) {
+    if (form_size <= 0 || form_size > (int)sizeof(challenge.initial_form_s)) {
         throw std::runtime_error("Invalid form size");
     }
     boost::asio::read(sock, boost::asio::buffer(initial_form_s, form_size), error);
@@ -12,7 +12,7 @@
 
 namespace {
 
-std::string run_init_session_with_payload(const std::vector<uint8_t>& payload) {
+std::string run_init_session_with_payload(const std::vector<uint8_t>& payload, SessionChallenge* out = nullptr) {
     boost::asio::io_context io;
     using boost::asio::ip::tcp;
 
@@ -37,7 +37,11 @@ std::string run_init_session_with_payload(const std::vector<uint8_t>& payload) {
     try {
         tcp::socket client(io);
         client.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
-        InitSession(client);
+        SessionChallenge challenge;
+        InitSession(client, challenge);
+        if (out != nullptr) {
+            *out = challenge;
+        }
     } catch (const std::exception& e) {
         error_message = e.what();
     }
@@ -87,13 +91,14 @@ TEST(VdfClientSessionRegressionTest, WrappedNegativeFormSizeIsRejected) {
 
 TEST(VdfClientSessionRegressionTest, ValidPayloadParsesWithoutProtocolOverread) {
     const std::vector<uint8_t> payload = {'0', '0', '3', 'a', 'b', 'c', 0x05, 0x10, 0x20, 0x30, 0x40, 0x50};
-    const std::string error = run_init_session_with_payload(payload);
+    SessionChallenge challenge;
+    const std::string error = run_init_session_with_payload(payload, &challenge);
     EXPECT_TRUE(error.empty());
 
-    EXPECT_EQ(std::strncmp(disc, "abc", 3), 0);
-    EXPECT_EQ(initial_form_s[0], 0x10);
-    EXPECT_EQ(initial_form_s[1], 0x20);
-    EXPECT_EQ(initial_form_s[2], 0x30);
-    EXPECT_EQ(initial_form_s[3], 0x40);
-    EXPECT_EQ(initial_form_s[4], 0x50);
+    EXPECT_EQ(std::strncmp(challenge.disc, "abc", 3), 0);
+    EXPECT_EQ(challenge.initial_form_s[0], 0x10);
+    EXPECT_EQ(challenge.initial_form_s[1], 0x20);
+    EXPECT_EQ(challenge.initial_form_s[2], 0x30);
+    EXPECT_EQ(challenge.initial_form_s[3], 0x40);
+    EXPECT_EQ(challenge.initial_form_s[4], 0x50);
 }
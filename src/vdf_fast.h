@@ -995,10 +995,12 @@ struct square_state_type {
 };
 
 #include "nudupl_listener.h"
+#include "thread_affinity.h"
 
 //this should never have an infinite loop
 //the gcd loops all have maximum counters after which they'll error out, and the thread_state loops also have a maximum spin counter
 void repeated_square_fast_work(square_state_type &square_state, bool is_slave, uint64 base, uint64 iterations, INUDUPLListener *nuduplListener) {
+    PinVdfThread(!is_slave, square_state.pairindex);
     c_thread_state.reset();
     c_thread_state.is_slave=is_slave;
     c_thread_state.pairindex=square_state.pairindex;
@@ -1073,6 +1075,8 @@ uint64 repeated_square_fast_single_thread(square_state_type &square_state, form&
 
     square_state.init(D, L, f.a, f.b);
 
+    PinVdfThread(true, square_state.pairindex);
+
     thread_state thread_state_master;
     thread_state thread_state_slave;
 
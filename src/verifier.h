@@ -8,6 +8,11 @@
 #include "nucomp.h"
 #include "proof_common.h"
 #include "create_discriminant.h"
+#include "verifier_context.h"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
 
 const uint8_t DEFAULT_ELEMENT[] = { 0x08 };
 
@@ -19,30 +24,34 @@ inline bool IsDiscSizeBitsInRange(const uint64_t disc_size_bits)
 inline bool IsDiscriminantInRange(const integer& D)
 {
     const int d_bits = D.num_bits();
-    return d_bits > 0 && static_cast<uint64_t>(d_bits) <= static_cast<uint64_t>(BQFC_MAX_D_BITS);
+    return mpz_sgn(D.impl) < 0 && static_cast<uint64_t>(d_bits) <= static_cast<uint64_t>(BQFC_MAX_D_BITS);
 }
 
-int VerifyWesoSegment(integer &D, form x, form proof, integer &B, uint64_t iters, form &out_y)
+int VerifyWesoSegment(integer &D, integer &L, PulmarkReducer& reducer, form x, form proof, integer &B, uint64_t iters, form &out_y)
 {
-    PulmarkReducer reducer;
-    integer L = root(-D, 4);
+    if (!IsBWellFormed(B))
+        return -1;
     integer r = FastPow(2, iters, B);
-    form f1 = FastPowFormNucomp(proof, D, B, L, reducer);
-    form f2 = FastPowFormNucomp(x, D, r, L, reducer);
-    out_y = f1 * f2;
+    out_y = FastMultiPowFormNucomp({proof, x}, {B, r}, D, L, reducer);
+    out_y.reduce();
 
     return B == GetB(D, x, out_y) ? 0 : -1;
 }
 
-void VerifyWesolowskiProof(integer &D, form x, form y, form proof, uint64_t iters, bool &is_valid)
+int VerifyWesoSegment(integer &D, form x, form proof, integer &B, uint64_t iters, form &out_y)
 {
-    PulmarkReducer reducer;
     integer L = root(-D, 4);
-    integer B = GetB(D, x, y);
+    return VerifyWesoSegment(D, L, GetThreadPulmarkReducer(), x, proof, B, iters, out_y);
+}
+
+void VerifyWesolowskiProof(VerifierContext& ctx, form x, form y, form proof, uint64_t iters, bool &is_valid)
+{
+    VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
+    integer B = GetB(ctx.D, x, y);
     integer r = FastPow(2, iters, B);
-    form f1 = FastPowFormNucomp(proof, D, B, L, reducer);
-    form f2 = FastPowFormNucomp(x, D, r, L, reducer);
-    if (f1 * f2 == y)
+    form f = FastMultiPowFormNucomp({proof, x}, {B, r}, ctx.D, ctx.L, reducer.get());
+    f.reduce();
+    if (f == y)
     {
         is_valid = true;
     }
@@ -52,10 +61,25 @@ void VerifyWesolowskiProof(integer &D, form x, form y, form proof, uint64_t iter
     }
 }
 
-bool CheckProofOfTimeNWesolowski(integer D, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64 disc_size_bits, uint64_t depth)
+void VerifyWesolowskiProof(integer &D, form x, form y, form proof, uint64_t iters, bool &is_valid)
+{
+    VerifyWesolowskiProof(*GetVerifierContext(D), x, y, proof, iters, is_valid);
+}
+
+// The final equation proof^B * x^r == y of an n-Wesolowski proof, left over
+// once all of its intermediate segments have been verified.
+struct WesolowskiClaim {
+    form x;
+    form y;
+    form proof;
+    integer B;
+    integer r;
+};
+
+// Checks that an n-Wesolowski blob of the given depth has exactly the
+// expected length: y | proof | depth * (iters | B | proof).
+bool IsNWesolowskiBlobLayoutValid(const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t depth)
 {
-    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(D))
-        return false;
     const size_t form_size = BQFC_FORM_SIZE;
     const size_t segment_len = 8 + B_bytes + form_size;
     const size_t base_len = 2 * form_size;
@@ -69,19 +93,32 @@ bool CheckProofOfTimeNWesolowski(integer D, const uint8_t* x_s, const uint8_t* p
         return false;
     if (x_s == nullptr || proof_blob == nullptr)
         return false;
+    return true;
+}
+
+// Validates the layout of an n-Wesolowski proof blob, verifies every
+// intermediate segment and fills in the claim for the final segment.
+// Returns false if the blob is malformed or any segment is invalid.
+// Throws if a form fails to deserialize.
+bool VerifyNWesolowskiSegments(integer &D, integer &L, PulmarkReducer& reducer, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth, WesolowskiClaim& claim)
+{
+    const size_t form_size = BQFC_FORM_SIZE;
+    const size_t segment_len = 8 + B_bytes + form_size;
+    const size_t base_len = 2 * form_size;
+    if (!IsNWesolowskiBlobLayoutValid(x_s, proof_blob, proof_blob_len, depth))
+        return false;
 
     // Walk segments from the end without unsigned underflow.
     size_t i = proof_blob_len;
     form x = DeserializeForm(D, x_s, form_size);
 
-    bool is_valid = false;
     while (i > base_len) {
         i -= segment_len;
         uint64_t segment_iters = BytesToInt64(&proof_blob[i]);
         form proof = DeserializeForm(D, &proof_blob[i + 8 + B_bytes], form_size);
         integer B(&proof_blob[i + 8], B_bytes);
         form xnew;
-        if (VerifyWesoSegment(D, x, proof, B, segment_iters, xnew))
+        if (VerifyWesoSegment(D, L, reducer, x, proof, B, segment_iters, xnew))
             return false;
 
         x = xnew;
@@ -92,15 +129,301 @@ bool CheckProofOfTimeNWesolowski(integer D, const uint8_t* x_s, const uint8_t* p
     }
 
     // Final forms are guaranteed to be in-bounds
-    VerifyWesolowskiProof(D, x,
-        DeserializeForm(D, proof_blob, form_size),
-        DeserializeForm(D, &proof_blob[form_size], form_size),
-        iterations, is_valid);
+    claim.x = x;
+    claim.y = DeserializeForm(D, proof_blob, form_size);
+    claim.proof = DeserializeForm(D, &proof_blob[form_size], form_size);
+    claim.B = GetB(D, claim.x, claim.y);
+    claim.r = FastPow(2, iterations, claim.B);
+    return true;
+}
 
-    return is_valid;
+bool VerifyWesolowskiClaim(integer &D, integer &L, PulmarkReducer& reducer, WesolowskiClaim& claim)
+{
+    form f = FastMultiPowFormNucomp({claim.proof, claim.x}, {claim.B, claim.r}, D, L, reducer);
+    f.reduce();
+    return f == claim.y;
 }
 
-bool CheckProofOfTimeNWesolowskiCommon(integer& D, form& x, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t& iterations, size_t last_segment, bool skip_check = false) {
+bool CheckProofOfTimeNWesolowski(VerifierContext& ctx, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64 disc_size_bits, uint64_t depth)
+{
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(ctx.D))
+        return false;
+
+    VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
+    WesolowskiClaim claim;
+    if (!VerifyNWesolowskiSegments(ctx.D, ctx.L, reducer.get(), x_s, proof_blob, proof_blob_len, iterations, depth, claim))
+        return false;
+
+    return VerifyWesolowskiClaim(ctx.D, ctx.L, reducer.get(), claim);
+}
+
+bool CheckProofOfTimeNWesolowski(integer D, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64 disc_size_bits, uint64_t depth)
+{
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(D))
+        return false;
+
+    return CheckProofOfTimeNWesolowski(*GetVerifierContext(D), x_s, proof_blob, proof_blob_len, iterations, disc_size_bits, depth);
+}
+
+// Runs task(i, reducer) for i in [0, n) on up to num_threads threads, each
+// with its own reducer leased from ctx. Stops handing out work once a task
+// returns false. Returns true if every task returned true; rethrows the
+// first exception.
+bool RunVerifierTasks(VerifierContext& ctx, size_t n, int num_threads, const std::function<bool(size_t, PulmarkReducer&)>& task)
+{
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
+        size_t i;
+        while (ok.load() && (i = next.fetch_add(1)) < n) {
+            try {
+                if (!task(i, reducer.get()))
+                    ok = false;
+            } catch (...) {
+                std::lock_guard<std::mutex> lk(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                ok = false;
+            }
+        }
+    };
+
+    size_t threads = std::min(n, static_cast<size_t>(std::max(num_threads, 1)));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& th : pool)
+        th.join();
+
+    if (error)
+        std::rethrow_exception(error);
+    return ok.load();
+}
+
+// Same verdict as CheckProofOfTimeNWesolowski, for validators with spare
+// cores. proof^B of each intermediate segment only depends on the blob, so
+// all of them are computed in parallel up front; then only the x^r steps of
+// the chain run sequentially, and the B == GetB(x, y) checks of every
+// segment run in parallel together with the final segment.
+// num_threads <= 0 uses all hardware threads. Unlike the sequential
+// verifier, every form is deserialized before any segment is checked.
+bool CheckProofOfTimeNWesolowskiParallel(VerifierContext& ctx, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64 disc_size_bits, uint64_t depth, int num_threads = 0)
+{
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(ctx.D))
+        return false;
+    if (!IsNWesolowskiBlobLayoutValid(x_s, proof_blob, proof_blob_len, depth))
+        return false;
+    if (num_threads <= 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const size_t form_size = BQFC_FORM_SIZE;
+    const size_t segment_len = 8 + B_bytes + form_size;
+    const size_t n = static_cast<size_t>(depth);
+    integer& D = ctx.D;
+    integer& L = ctx.L;
+
+    // Segments in chain order: the blob stores them last-to-first.
+    std::vector<uint64_t> segment_iters(n);
+    std::vector<integer> Bs(n);
+    std::vector<form> proof_B(n);
+    std::vector<form> xs(n + 1);
+    xs[0] = DeserializeForm(D, x_s, form_size);
+    for (size_t k = 0; k < n; k++) {
+        size_t i = proof_blob_len - (k + 1) * segment_len;
+        segment_iters[k] = BytesToInt64(&proof_blob[i]);
+        if (segment_iters[k] > iterations)
+            return false;
+        iterations -= segment_iters[k];
+        Bs[k] = integer(&proof_blob[i + 8], B_bytes);
+        if (!IsBWellFormed(Bs[k]))
+            return false;
+        proof_B[k] = DeserializeForm(D, &proof_blob[i + 8 + B_bytes], form_size);
+    }
+    WesolowskiClaim claim;
+    claim.y = DeserializeForm(D, proof_blob, form_size);
+    claim.proof = DeserializeForm(D, &proof_blob[form_size], form_size);
+
+    RunVerifierTasks(ctx, n, num_threads, [&](size_t k, PulmarkReducer& reducer) {
+        proof_B[k] = FastPowFormNucomp(proof_B[k], D, Bs[k], L, reducer);
+        return true;
+    });
+
+    {
+        VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
+        for (size_t k = 0; k < n; k++) {
+            integer r = FastPow(2, segment_iters[k], Bs[k]);
+            xs[k + 1] = FastPowFormNucomp(xs[k], D, r, L, reducer.get());
+            nucomp_form(xs[k + 1], xs[k + 1], proof_B[k], D, L);
+            reducer.get().reduce(xs[k + 1]);
+            xs[k + 1].reduce();
+        }
+    }
+
+    // Task n is the final segment; the rest check one intermediate B each.
+    claim.x = xs[n];
+    return RunVerifierTasks(ctx, n + 1, num_threads, [&](size_t k, PulmarkReducer& reducer) {
+        if (k < n) {
+            form x = xs[k], y = xs[k + 1];
+            return Bs[k] == GetB(D, x, y);
+        }
+        claim.B = GetB(D, claim.x, claim.y);
+        claim.r = FastPow(2, iterations, claim.B);
+        return VerifyWesolowskiClaim(D, L, reducer, claim);
+    });
+}
+
+bool CheckProofOfTimeNWesolowskiParallel(integer D, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64 disc_size_bits, uint64_t depth, int num_threads = 0)
+{
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(D))
+        return false;
+
+    return CheckProofOfTimeNWesolowskiParallel(*GetVerifierContext(D), x_s, proof_blob, proof_blob_len, iterations, disc_size_bits, depth, num_threads);
+}
+
+// One n-Wesolowski proof handed to CheckProofOfTimeNWesolowskiBatch; the
+// fields mirror the arguments of CheckProofOfTimeNWesolowski.
+struct NWesolowskiBatchItem {
+    std::vector<uint8_t> x_s;
+    std::vector<uint8_t> proof_blob;
+    uint64_t iterations = 0;
+    uint64_t depth = 0;
+};
+
+// Bit length of the random exponents used to fold claims together. A batch
+// containing an invalid claim passes with probability about 2^-128.
+const int kBatchRandomizerBits = 128;
+
+// Derives one odd (hence nonzero) randomizer per claim by hashing the claims
+// together with fresh local entropy, so a prover can neither predict nor
+// grind the exponents.
+std::vector<integer> GetBatchRandomizers(std::vector<WesolowskiClaim>& claims, const std::vector<size_t>& idx, int d_bits)
+{
+    std::vector<uint8_t> transcript;
+    std::random_device rd;
+    for (int i = 0; i < 8; i++) {
+        uint32_t v = rd();
+        transcript.insert(transcript.end(), (uint8_t*)&v, (uint8_t*)&v + sizeof(v));
+    }
+    for (size_t i : idx) {
+        WesolowskiClaim& claim = claims[i];
+        // B commits to both x and y.
+        std::vector<uint8_t> B_bytes_vec = claim.B.to_bytes();
+        std::vector<uint8_t> proof_bytes = SerializeForm(claim.proof, d_bits);
+        std::vector<uint8_t> r_bytes = claim.r.to_bytes();
+        transcript.insert(transcript.end(), B_bytes_vec.begin(), B_bytes_vec.end());
+        transcript.insert(transcript.end(), proof_bytes.begin(), proof_bytes.end());
+        transcript.insert(transcript.end(), r_bytes.begin(), r_bytes.end());
+    }
+    std::vector<uint8_t> seed(picosha2::k_digest_size);
+    picosha2::hash256(transcript.begin(), transcript.end(), seed.begin(), seed.end());
+
+    std::vector<integer> rhos(claims.size());
+    std::vector<uint8_t> block(seed);
+    block.resize(seed.size() + 8);
+    std::vector<uint8_t> hash(picosha2::k_digest_size);
+    for (size_t i : idx) {
+        Int64ToBytes(&block[seed.size()], i);
+        picosha2::hash256(block.begin(), block.end(), hash.begin(), hash.end());
+        integer rho(hash.data(), kBatchRandomizerBits / 8);
+        rho.set_bit(0, true);
+        rhos[i] = rho;
+    }
+    return rhos;
+}
+
+// Checks prod (proof^B * x^r * y^-1)^rho == 1 over claims[idx[begin..end)]
+// with a single multi-exponentiation. Valid claims always pass.
+bool BatchCheckWesolowskiClaims(integer &D, integer &L, PulmarkReducer& reducer, const std::vector<WesolowskiClaim>& claims, const std::vector<integer>& rhos, const std::vector<size_t>& idx, size_t begin, size_t end)
+{
+    std::vector<form> bases;
+    std::vector<integer> exponents;
+    bases.reserve(3 * (end - begin));
+    exponents.reserve(3 * (end - begin));
+    for (size_t i = begin; i < end; i++) {
+        const WesolowskiClaim& claim = claims[idx[i]];
+        const integer& rho = rhos[idx[i]];
+        bases.push_back(claim.proof);
+        exponents.push_back(claim.B * rho);
+        bases.push_back(claim.x);
+        exponents.push_back(claim.r * rho);
+        bases.push_back(claim.y.inverse());
+        exponents.push_back(rho);
+    }
+    form res = FastMultiPowFormNucomp(bases, exponents, D, L, reducer);
+    // Only forms in the principal class represent 1.
+    return mpz_cmp_ui(res.a.impl, 1) == 0;
+}
+
+// Checks the claims in idx[begin..end) as one batch and, on failure, bisects
+// until every invalid claim has been isolated and rejected individually.
+void VerifyWesolowskiClaimsBatch(integer &D, integer &L, PulmarkReducer& reducer, std::vector<WesolowskiClaim>& claims, const std::vector<integer>& rhos, const std::vector<size_t>& idx, size_t begin, size_t end, std::vector<bool>& results)
+{
+    if (begin >= end)
+        return;
+    if (end - begin == 1) {
+        results[idx[begin]] = VerifyWesolowskiClaim(D, L, reducer, claims[idx[begin]]);
+        return;
+    }
+    if (BatchCheckWesolowskiClaims(D, L, reducer, claims, rhos, idx, begin, end)) {
+        for (size_t i = begin; i < end; i++)
+            results[idx[i]] = true;
+        return;
+    }
+    size_t mid = begin + (end - begin) / 2;
+    VerifyWesolowskiClaimsBatch(D, L, reducer, claims, rhos, idx, begin, mid, results);
+    VerifyWesolowskiClaimsBatch(D, L, reducer, claims, rhos, idx, mid, end, results);
+}
+
+// Verifies many n-Wesolowski proofs over the same discriminant. The
+// per-discriminant setup is done once, intermediate segments are checked one
+// by one, and the final segments are folded into a randomized batch check.
+// Returns one verdict per item, in order; an item that fails to deserialize
+// is reported invalid rather than aborting the batch.
+std::vector<bool> CheckProofOfTimeNWesolowskiBatch(VerifierContext& ctx, const std::vector<NWesolowskiBatchItem>& items, uint64_t disc_size_bits)
+{
+    std::vector<bool> results(items.size(), false);
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(ctx.D))
+        return results;
+
+    VerifierContext::ReducerLease lease = ctx.AcquireReducer();
+    PulmarkReducer& reducer = lease.get();
+    integer& D = ctx.D;
+    integer& L = ctx.L;
+    std::vector<WesolowskiClaim> claims(items.size());
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < items.size(); i++) {
+        const NWesolowskiBatchItem& item = items[i];
+        if (item.x_s.size() < BQFC_FORM_SIZE)
+            continue;
+        try {
+            if (VerifyNWesolowskiSegments(D, L, reducer, item.x_s.data(), item.proof_blob.data(), item.proof_blob.size(), item.iterations, item.depth, claims[i]))
+                pending.push_back(i);
+        } catch (const std::exception&) {
+            // Malformed forms make this item invalid, not the whole batch.
+        }
+    }
+
+    if (!pending.empty()) {
+        std::vector<integer> rhos = GetBatchRandomizers(claims, pending, ctx.d_bits);
+        VerifyWesolowskiClaimsBatch(D, L, reducer, claims, rhos, pending, 0, pending.size(), results);
+    }
+    return results;
+}
+
+std::vector<bool> CheckProofOfTimeNWesolowskiBatch(integer D, const std::vector<NWesolowskiBatchItem>& items, uint64_t disc_size_bits)
+{
+    if (!IsDiscSizeBitsInRange(disc_size_bits) || !IsDiscriminantInRange(D))
+        return std::vector<bool>(items.size(), false);
+
+    return CheckProofOfTimeNWesolowskiBatch(*GetVerifierContext(D), items, disc_size_bits);
+}
+
+bool CheckProofOfTimeNWesolowskiCommon(integer& D, integer& L, PulmarkReducer& reducer, form& x, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t& iterations, size_t last_segment, bool skip_check = false) {
     const size_t form_size = BQFC_FORM_SIZE;
     const size_t segment_len = 8 + B_bytes + form_size;
     if (proof_blob == nullptr) return false;
@@ -108,7 +431,6 @@ bool CheckProofOfTimeNWesolowskiCommon(integer& D, form& x, const uint8_t* proof
     if ((proof_blob_len - last_segment) % segment_len != 0)
         return false;    
     size_t i = proof_blob_len;
-    PulmarkReducer reducer;
 
     while (i > last_segment) {
         i -= segment_len;
@@ -117,14 +439,12 @@ bool CheckProofOfTimeNWesolowskiCommon(integer& D, form& x, const uint8_t* proof
         integer B(&proof_blob[i + 8], B_bytes);
         form xnew;
         if (!skip_check) {
-            if (VerifyWesoSegment(D, x, proof, B, segment_iters, xnew))
+            if (VerifyWesoSegment(D, L, reducer, x, proof, B, segment_iters, xnew))
                 return false;
         } else {
-            integer L = root(-D, 4);
             integer r = FastPow(2, segment_iters, B);
-            form f1 = FastPowFormNucomp(proof, D, B, L, reducer);
-            form f2 = FastPowFormNucomp(x, D, r, L, reducer);
-            xnew = f1 * f2;
+            xnew = FastMultiPowFormNucomp({proof, x}, {B, r}, D, L, reducer);
+            xnew.reduce();
         }
 
         x = xnew;
@@ -136,8 +456,15 @@ bool CheckProofOfTimeNWesolowskiCommon(integer& D, form& x, const uint8_t* proof
     return true;
 }
 
-std::pair<bool, std::vector<uint8_t>> CheckProofOfTimeNWesolowskiWithB(integer D, integer B, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+bool CheckProofOfTimeNWesolowskiCommon(integer& D, form& x, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t& iterations, size_t last_segment, bool skip_check = false) {
+    integer L = root(-D, 4);
+    return CheckProofOfTimeNWesolowskiCommon(D, L, GetThreadPulmarkReducer(), x, proof_blob, proof_blob_len, iterations, last_segment, skip_check);
+}
+
+std::pair<bool, std::vector<uint8_t>> CheckProofOfTimeNWesolowskiWithB(VerifierContext& ctx, integer B, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+    integer& D = ctx.D;
     if (!IsDiscriminantInRange(D)) return {false, {}};
+    VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
     const size_t form_size = BQFC_FORM_SIZE;
     const size_t segment_len = 8 + B_bytes + form_size;
     const uint64_t max_depth = static_cast<uint64_t>((std::numeric_limits<size_t>::max() - form_size) / segment_len);
@@ -147,23 +474,29 @@ std::pair<bool, std::vector<uint8_t>> CheckProofOfTimeNWesolowskiWithB(integer D
     if (depth > max_depth || proof_blob_len != form_size + static_cast<size_t>(depth) * segment_len) {
         return {false, result};
     }
-    bool is_valid = CheckProofOfTimeNWesolowskiCommon(D, x, proof_blob, proof_blob_len, iterations, form_size);
+    bool is_valid = CheckProofOfTimeNWesolowskiCommon(D, ctx.L, reducer.get(), x, proof_blob, proof_blob_len, iterations, form_size);
     if (is_valid == false) {
         return {false, result};
     }
     if (form_size > proof_blob_len) return {false, result};
     form proof = DeserializeForm(D, proof_blob, form_size);
     form y_result;
-    if (VerifyWesoSegment(D, x, proof, B, iterations, y_result) == -1) {
+    if (VerifyWesoSegment(D, ctx.L, reducer.get(), x, proof, B, iterations, y_result) == -1) {
         return {false, result};
     }
-    int d_bits = D.num_bits();
-    result = SerializeForm(y_result, d_bits);
+    result = SerializeForm(y_result, ctx.d_bits);
     return {true, result};
 }
 
-integer GetBFromProof(integer D, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+std::pair<bool, std::vector<uint8_t>> CheckProofOfTimeNWesolowskiWithB(integer D, integer B, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+    if (!IsDiscriminantInRange(D)) return {false, {}};
+    return CheckProofOfTimeNWesolowskiWithB(*GetVerifierContext(D), B, x_s, proof_blob, proof_blob_len, iterations, depth);
+}
+
+integer GetBFromProof(VerifierContext& ctx, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+    integer& D = ctx.D;
     if (!IsDiscriminantInRange(D)) throw std::runtime_error("Invalid proof.");
+    VerifierContext::ReducerLease reducer = ctx.AcquireReducer();
     const size_t form_size = BQFC_FORM_SIZE;
     const size_t segment_len = 8 + B_bytes + form_size;
     const size_t base_len = 2 * form_size;
@@ -173,7 +506,7 @@ integer GetBFromProof(integer D, const uint8_t* x_s, const uint8_t* proof_blob,
     if (depth > max_depth || proof_blob_len != base_len + static_cast<size_t>(depth) * segment_len) {
         throw std::runtime_error("Invalid proof.");
     }
-    bool is_valid = CheckProofOfTimeNWesolowskiCommon(D, x, proof_blob, proof_blob_len, iterations, 2 * form_size, true);
+    bool is_valid = CheckProofOfTimeNWesolowskiCommon(D, ctx.L, reducer.get(), x, proof_blob, proof_blob_len, iterations, 2 * form_size, true);
     if (is_valid == false) {
         throw std::runtime_error("Invalid proof.");
     }
@@ -182,6 +515,11 @@ integer GetBFromProof(integer D, const uint8_t* x_s, const uint8_t* proof_blob,
     return GetB(D, x, y);
 }
 
+integer GetBFromProof(integer D, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth) {
+    if (!IsDiscriminantInRange(D)) throw std::runtime_error("Invalid proof.");
+    return GetBFromProof(*GetVerifierContext(D), x_s, proof_blob, proof_blob_len, iterations, depth);
+}
+
 bool CreateDiscriminantAndCheckProofOfTimeNWesolowski(std::vector<uint8_t> seed, uint32 disc_size_bits, const uint8_t* x_s, const uint8_t* proof_blob, size_t proof_blob_len, uint64_t iterations, uint64_t depth)
 {
     if (!IsDiscSizeBitsInRange(disc_size_bits))
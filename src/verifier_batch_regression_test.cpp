@@ -0,0 +1,86 @@
+#include "verifier.h"
+#include "prover_slow.h"
+#include "create_discriminant.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+integer get_batch_discriminant() {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    return CreateDiscriminant(challenge_hash, 1024);
+}
+
+std::vector<NWesolowskiBatchItem> make_batch_items(integer& d, const std::vector<uint64_t>& iterations) {
+    form x = form::generator(d);
+    std::vector<uint8_t> x_s = SerializeForm(x, d.num_bits());
+    std::vector<NWesolowskiBatchItem> items;
+    for (uint64_t iters : iterations) {
+        NWesolowskiBatchItem item;
+        item.x_s = x_s;
+        item.proof_blob = ProveSlow(d, x, iters, "");
+        item.iterations = iters;
+        item.depth = 0;
+        items.push_back(item);
+    }
+    return items;
+}
+
+}  // namespace
+
+TEST(VerifierBatchRegressionTest, MultiPowMatchesSeparateExponentiations) {
+    integer d = get_batch_discriminant();
+    integer L = root(-d, 4);
+    PulmarkReducer reducer;
+    form g = form::generator(d);
+    form h = FastPowFormNucomp(g, d, integer(12345), L, reducer);
+
+    std::vector<form> bases({g, h, g});
+    std::vector<integer> exponents({integer("0xdeadbeefcafebabe1234"), integer(777), integer(0)});
+    form expected = FastPowFormNucomp(g, d, exponents[0], L, reducer) *
+                    FastPowFormNucomp(h, d, exponents[1], L, reducer);
+    form actual = FastMultiPowFormNucomp(bases, exponents, d, L, reducer);
+    actual.reduce();
+    EXPECT_EQ(actual, expected);
+
+    std::vector<integer> zeros({integer(0), integer(0), integer(0)});
+    EXPECT_EQ(FastMultiPowFormNucomp(bases, zeros, d, L, reducer), form::identity(d));
+}
+
+TEST(VerifierBatchRegressionTest, AcceptsValidProofsIncludingDuplicates) {
+    integer d = get_batch_discriminant();
+    std::vector<NWesolowskiBatchItem> items = make_batch_items(d, {100, 1000, 2000});
+    items.push_back(items[1]);
+
+    std::vector<bool> results = CheckProofOfTimeNWesolowskiBatch(d, items, 1024);
+    ASSERT_EQ(results.size(), items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        EXPECT_TRUE(results[i]) << "item " << i;
+        EXPECT_TRUE(CheckProofOfTimeNWesolowski(d, items[i].x_s.data(), items[i].proof_blob.data(),
+                                                items[i].proof_blob.size(), items[i].iterations, 1024, 0));
+    }
+}
+
+TEST(VerifierBatchRegressionTest, PinpointsInvalidAndMalformedProofs) {
+    integer d = get_batch_discriminant();
+    std::vector<NWesolowskiBatchItem> items = make_batch_items(d, {100, 500, 1000, 1500, 2000});
+
+    // Valid forms, wrong claim: the batch check fails and bisection must find it.
+    items[2].iterations = 1001;
+    // Malformed proof form.
+    items[4].proof_blob[BQFC_FORM_SIZE + 1] = 0xFF;
+
+    std::vector<bool> results = CheckProofOfTimeNWesolowskiBatch(d, items, 1024);
+    std::vector<bool> expected({true, true, false, true, false});
+    EXPECT_EQ(results, expected);
+}
+
+TEST(VerifierBatchRegressionTest, RejectsEverythingForOutOfRangeDiscriminantSize) {
+    integer d = get_batch_discriminant();
+    std::vector<NWesolowskiBatchItem> items = make_batch_items(d, {100});
+    EXPECT_EQ(CheckProofOfTimeNWesolowskiBatch(d, items, 0), std::vector<bool>({false}));
+    EXPECT_TRUE(CheckProofOfTimeNWesolowskiBatch(d, {}, 1024).empty());
+}
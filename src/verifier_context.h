@@ -0,0 +1,168 @@
+#ifndef VERIFIER_CONTEXT_H
+#define VERIFIER_CONTEXT_H
+
+#include "include.h"
+#include "integer_common.h"
+#include "proof_common.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Per-discriminant state shared by verifications: D, L = root(-D, 4), the
+// size of D in bits and a pool of Pulmark reducers. A context may be shared
+// between threads; every verification leases its own reducer.
+class VerifierContext {
+  public:
+    integer D;
+    integer L;
+    int d_bits;
+
+    explicit VerifierContext(const integer& discriminant) : D(discriminant) {
+        if (mpz_sgn(D.impl) >= 0) {
+            throw std::invalid_argument("VerifierContext: discriminant must be negative");
+        }
+        L = root(-D, 4);
+        d_bits = D.num_bits();
+    }
+
+    VerifierContext(const VerifierContext&) = delete;
+    VerifierContext& operator=(const VerifierContext&) = delete;
+
+    // Hands out a pooled reducer and returns it to the pool when destroyed.
+    class ReducerLease {
+        VerifierContext* owner;
+        std::unique_ptr<PulmarkReducer> reducer;
+
+      public:
+        ReducerLease(VerifierContext* owner, std::unique_ptr<PulmarkReducer> reducer)
+            : owner(owner), reducer(std::move(reducer)) {}
+        ReducerLease(ReducerLease&& other) = default;
+        ReducerLease(const ReducerLease&) = delete;
+        ReducerLease& operator=(const ReducerLease&) = delete;
+        ReducerLease& operator=(ReducerLease&&) = delete;
+
+        ~ReducerLease() {
+            if (reducer)
+                owner->ReleaseReducer(std::move(reducer));
+        }
+
+        PulmarkReducer& get() { return *reducer; }
+    };
+
+    ReducerLease AcquireReducer() {
+        {
+            std::lock_guard<std::mutex> lk(reducers_mutex);
+            if (!reducers.empty()) {
+                std::unique_ptr<PulmarkReducer> reducer = std::move(reducers.back());
+                reducers.pop_back();
+                return ReducerLease(this, std::move(reducer));
+            }
+        }
+        return ReducerLease(this, std::unique_ptr<PulmarkReducer>(new PulmarkReducer()));
+    }
+
+  private:
+    // Reducers beyond this many are freed instead of pooled.
+    static const size_t kMaxPooledReducers = 64;
+
+    std::mutex reducers_mutex;
+    std::vector<std::unique_ptr<PulmarkReducer>> reducers;
+
+    void ReleaseReducer(std::unique_ptr<PulmarkReducer> reducer) {
+        std::lock_guard<std::mutex> lk(reducers_mutex);
+        if (reducers.size() < kMaxPooledReducers)
+            reducers.push_back(std::move(reducer));
+    }
+};
+
+const size_t kDefaultVerifierContextCacheSize = 64;
+
+// Thread-safe LRU of verifier contexts keyed by the magnitude bytes of the
+// discriminant. Contexts are handed out as shared_ptr, so evicting one never
+// invalidates a verification that is still using it.
+class VerifierContextCache {
+  public:
+    explicit VerifierContextCache(size_t capacity) : capacity(capacity) {}
+
+    std::shared_ptr<VerifierContext> Get(const integer& D) {
+        std::vector<uint8_t> bytes = D.to_bytes();
+        std::string key(bytes.begin(), bytes.end());
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            auto it = index.find(key);
+            if (it != index.end()) {
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->second;
+            }
+        }
+
+        // Build outside the lock; a concurrent miss on the same key keeps
+        // whichever context was inserted first.
+        std::shared_ptr<VerifierContext> ctx = std::make_shared<VerifierContext>(D);
+        std::lock_guard<std::mutex> lk(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+        if (capacity == 0)
+            return ctx;
+        lru.emplace_front(key, ctx);
+        index[key] = lru.begin();
+        EvictLocked();
+        return ctx;
+    }
+
+    // A capacity of 0 disables caching.
+    void SetCapacity(size_t new_capacity) {
+        std::lock_guard<std::mutex> lk(mutex);
+        capacity = new_capacity;
+        EvictLocked();
+    }
+
+    size_t GetCapacity() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return capacity;
+    }
+
+    size_t Size() {
+        std::lock_guard<std::mutex> lk(mutex);
+        return lru.size();
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lk(mutex);
+        index.clear();
+        lru.clear();
+    }
+
+  private:
+    typedef std::list<std::pair<std::string, std::shared_ptr<VerifierContext>>> lru_list;
+
+    std::mutex mutex;
+    size_t capacity;
+    lru_list lru;
+    std::unordered_map<std::string, lru_list::iterator> index;
+
+    void EvictLocked() {
+        while (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+};
+
+VerifierContextCache& GetVerifierContextCache()
+{
+    static VerifierContextCache cache(kDefaultVerifierContextCacheSize);
+    return cache;
+}
+
+// Returns the cached context for D, creating it on a miss.
+std::shared_ptr<VerifierContext> GetVerifierContext(const integer& D)
+{
+    return GetVerifierContextCache().Get(D);
+}
+
+#endif // VERIFIER_CONTEXT_H
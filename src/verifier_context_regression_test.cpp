@@ -0,0 +1,158 @@
+#include "verifier.h"
+#include "prover_slow.h"
+#include "create_discriminant.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+integer get_context_discriminant(uint8_t tag) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, tag});
+    return CreateDiscriminant(challenge_hash, 512);
+}
+
+}  // namespace
+
+TEST(VerifierContextRegressionTest, CacheEvictsLeastRecentlyUsed) {
+    VerifierContextCache cache(2);
+    integer d1 = get_context_discriminant(1);
+    integer d2 = get_context_discriminant(2);
+    integer d3 = get_context_discriminant(3);
+
+    std::shared_ptr<VerifierContext> c1 = cache.Get(d1);
+    EXPECT_EQ(cache.Get(d1), c1);
+    EXPECT_EQ(c1->L, root(-d1, 4));
+    EXPECT_EQ(c1->d_bits, d1.num_bits());
+
+    cache.Get(d2);
+    cache.Get(d1);  // d2 is now least recently used.
+    cache.Get(d3);
+    EXPECT_EQ(cache.Size(), 2U);
+    EXPECT_EQ(cache.Get(d1), c1);
+
+    // Evicted contexts stay usable by their holders.
+    cache.Clear();
+    EXPECT_EQ(cache.Size(), 0U);
+    EXPECT_NE(cache.Get(d1), c1);
+    EXPECT_EQ(c1->D, d1);
+
+    cache.SetCapacity(0);
+    EXPECT_EQ(cache.Size(), 0U);
+    cache.Get(d2);
+    EXPECT_EQ(cache.Size(), 0U);
+}
+
+TEST(VerifierContextRegressionTest, RejectsNonNegativeDiscriminant) {
+    EXPECT_THROW(VerifierContext ctx(integer(7)), std::invalid_argument);
+    EXPECT_FALSE(IsDiscriminantInRange(integer(7)));
+}
+
+TEST(VerifierContextRegressionTest, ContextVerificationMatchesUncached) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form x = form::generator(d);
+    std::vector<uint8_t> x_s = SerializeForm(x, d.num_bits());
+    std::vector<uint8_t> blob = ProveSlow(d, x, 1000, "");
+
+    std::shared_ptr<VerifierContext> ctx = GetVerifierContext(d);
+    for (int i = 0; i < 2; i++) {
+        EXPECT_TRUE(CheckProofOfTimeNWesolowski(*ctx, x_s.data(), blob.data(), blob.size(), 1000, 1024, 0));
+        EXPECT_FALSE(CheckProofOfTimeNWesolowski(*ctx, x_s.data(), blob.data(), blob.size(), 999, 1024, 0));
+    }
+    EXPECT_EQ(GetBFromProof(*ctx, x_s.data(), blob.data(), blob.size(), 1000, 0),
+              GetBFromProof(d, x_s.data(), blob.data(), blob.size(), 1000, 0));
+}
+
+TEST(VerifierContextRegressionTest, IntegerEntryPointsShareTheProcessCache) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 5});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form x = form::generator(d);
+    std::vector<uint8_t> x_s = SerializeForm(x, d.num_bits());
+    std::vector<uint8_t> blob = ProveSlow(d, x, 1000, "");
+
+    GetVerifierContextCache().Clear();
+    EXPECT_TRUE(CheckProofOfTimeNWesolowski(d, x_s.data(), blob.data(), blob.size(), 1000, 1024, 0));
+    EXPECT_TRUE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), blob.data(), blob.size(), 1000, 1024, 0, 2));
+    EXPECT_EQ(GetVerifierContextCache().Size(), 1U);
+
+    // Out-of-range discriminants are rejected before reaching the cache.
+    EXPECT_FALSE(CheckProofOfTimeNWesolowski(-d, x_s.data(), blob.data(), blob.size(), 1000, 1024, 0));
+    EXPECT_THROW(GetBFromProof(-d, x_s.data(), blob.data(), blob.size(), 1000, 0), std::runtime_error);
+    EXPECT_EQ(GetVerifierContextCache().Size(), 1U);
+    GetVerifierContextCache().Clear();
+}
+
+TEST(VerifierContextRegressionTest, BCacheEvictsLeastRecentlyUsed) {
+    BCache cache(2);
+    integer B;
+    EXPECT_FALSE(cache.Get("a", B));
+    cache.Put("a", integer(3));
+    cache.Put("b", integer(5));
+    EXPECT_TRUE(cache.Get("a", B));  // b is now least recently used.
+    EXPECT_EQ(B, integer(3));
+    cache.Put("c", integer(7));
+    EXPECT_EQ(cache.Size(), 2U);
+    EXPECT_FALSE(cache.Get("b", B));
+    EXPECT_TRUE(cache.Get("c", B));
+    EXPECT_EQ(B, integer(7));
+
+    cache.SetCapacity(0);
+    EXPECT_EQ(cache.Size(), 0U);
+    cache.Put("a", integer(3));
+    EXPECT_FALSE(cache.Get("a", B));
+}
+
+TEST(VerifierContextRegressionTest, GetBServesRepeatsFromTheCache) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form x = form::generator(d);
+    form y = x * x;
+    std::vector<uint8_t> serialization = SerializeForm(x, d.num_bits());
+    std::vector<uint8_t> y_serialization = SerializeForm(y, d.num_bits());
+    serialization.insert(serialization.end(), y_serialization.begin(), y_serialization.end());
+    integer expected = HashPrime(serialization, B_bits, {B_bits - 1});
+    EXPECT_TRUE(IsBWellFormed(expected));
+
+    GetBCache().Clear();
+    EXPECT_EQ(GetB(d, x, y), expected);
+    EXPECT_EQ(GetBCache().Size(), 1U);
+    EXPECT_EQ(GetB(d, x, y), expected);
+    EXPECT_EQ(GetBCache().Size(), 1U);
+
+    GetBCache().SetCapacity(0);
+    EXPECT_EQ(GetB(d, x, y), expected);
+    EXPECT_EQ(GetBCache().Size(), 0U);
+    GetBCache().SetCapacity(kDefaultBCacheSize);
+}
+
+TEST(VerifierContextRegressionTest, MalformedEmbeddedBIsRejected) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    integer L = root(-d, 4);
+    form x = form::generator(d);
+    std::vector<uint8_t> x_s = SerializeForm(x, d.num_bits());
+    std::vector<uint8_t> blob = ProveSlow(d, x, 1000, "");
+    form y = DeserializeForm(d, blob.data(), BQFC_FORM_SIZE);
+    form proof = DeserializeForm(d, blob.data() + BQFC_FORM_SIZE, BQFC_FORM_SIZE);
+    integer B = GetB(d, x, y);
+
+    form out_y;
+    EXPECT_EQ(VerifyWesoSegment(d, L, GetThreadPulmarkReducer(), x, proof, B, 1000, out_y), 0);
+    EXPECT_EQ(out_y, y);
+    for (integer bad : {B >> 1, B << 1, B + integer(1), integer(0) - B}) {
+        EXPECT_FALSE(IsBWellFormed(bad));
+        EXPECT_EQ(VerifyWesoSegment(d, L, GetThreadPulmarkReducer(), x, proof, bad, 1000, out_y), -1);
+    }
+
+    // The proof without y, checked against the B get_b_from_n_wesolowski
+    // would return; the second check reuses the cached B.
+    std::vector<uint8_t> proof_only(blob.begin() + BQFC_FORM_SIZE, blob.end());
+    for (int i = 0; i < 2; i++) {
+        auto result = CheckProofOfTimeNWesolowskiWithB(d, B, x_s.data(), proof_only.data(), proof_only.size(), 1000, 0);
+        EXPECT_TRUE(result.first);
+        EXPECT_EQ(result.second, std::vector<uint8_t>(blob.begin(), blob.begin() + BQFC_FORM_SIZE));
+    }
+}
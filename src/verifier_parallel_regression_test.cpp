@@ -0,0 +1,68 @@
+#include "verifier.h"
+#include "prover_slow.h"
+#include "create_discriminant.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Builds an n-Wesolowski blob by chaining ProveSlow over `chain`
+// iteration counts: y | proof | segments, with the latest segment first.
+std::vector<uint8_t> make_n_weso_blob(integer& d, form x, const std::vector<uint64_t>& chain) {
+    std::vector<uint8_t> segments;
+    std::vector<uint8_t> last;
+    for (size_t k = 0; k < chain.size(); k++) {
+        std::vector<uint8_t> blob = ProveSlow(d, x, chain[k], "");
+        form y = DeserializeForm(d, blob.data(), BQFC_FORM_SIZE);
+        if (k + 1 == chain.size()) {
+            last = blob;
+            break;
+        }
+        std::vector<uint8_t> segment(8);
+        Int64ToBytes(segment.data(), chain[k]);
+        std::vector<uint8_t> b = GetB(d, x, y).to_bytes();
+        segment.insert(segment.end(), b.begin(), b.end());
+        segment.insert(segment.end(), blob.begin() + BQFC_FORM_SIZE, blob.end());
+        segments.insert(segments.begin(), segment.begin(), segment.end());
+        x = y;
+    }
+    last.insert(last.end(), segments.begin(), segments.end());
+    return last;
+}
+
+}  // namespace
+
+TEST(VerifierParallelRegressionTest, MatchesSequentialVerifier) {
+    std::vector<uint8_t> challenge_hash({0, 0, 1, 2, 3, 3, 4, 4});
+    integer d = CreateDiscriminant(challenge_hash, 1024);
+    form x = form::generator(d);
+    std::vector<uint8_t> x_s = SerializeForm(x, d.num_bits());
+    std::vector<uint64_t> chain({300, 500, 700});
+    const uint64_t total = 1500, depth = 2;
+    std::vector<uint8_t> blob = make_n_weso_blob(d, x, chain);
+    const size_t segment_len = 8 + B_bytes + BQFC_FORM_SIZE;
+    ASSERT_EQ(blob.size(), 2 * BQFC_FORM_SIZE + depth * segment_len);
+
+    EXPECT_TRUE(CheckProofOfTimeNWesolowski(d, x_s.data(), blob.data(), blob.size(), total, 1024, depth));
+    for (int threads : {1, 2, 4}) {
+        EXPECT_TRUE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), blob.data(), blob.size(), total, 1024, depth, threads));
+        EXPECT_FALSE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), blob.data(), blob.size(), total + 1, 1024, depth, threads));
+        EXPECT_FALSE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), blob.data(), blob.size(), total, 1024, depth + 1, threads));
+    }
+
+    // Corrupt the B of the first chained segment (stored last in the blob).
+    std::vector<uint8_t> bad_b = blob;
+    bad_b[blob.size() - segment_len + 8 + B_bytes - 1] ^= 0x02;
+    EXPECT_FALSE(CheckProofOfTimeNWesolowski(d, x_s.data(), bad_b.data(), bad_b.size(), total, 1024, depth));
+    EXPECT_FALSE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), bad_b.data(), bad_b.size(), total, 1024, depth, 4));
+
+    // Swap the iteration counts of the two segments.
+    std::vector<uint8_t> swapped = blob;
+    Int64ToBytes(&swapped[2 * BQFC_FORM_SIZE], 300);
+    Int64ToBytes(&swapped[2 * BQFC_FORM_SIZE + segment_len], 500);
+    EXPECT_FALSE(CheckProofOfTimeNWesolowski(d, x_s.data(), swapped.data(), swapped.size(), total, 1024, depth));
+    EXPECT_FALSE(CheckProofOfTimeNWesolowskiParallel(d, x_s.data(), swapped.data(), swapped.size(), total, 1024, depth, 4));
+}
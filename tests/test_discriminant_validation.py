@@ -32,3 +32,13 @@ def test_discriminant_size_bits_valid():
     # If we get here without an exception, the test passes
     assert discriminant is not None
     assert len(discriminant) > 0  # Should return a string representation of the discriminant
+
+
+def test_discriminant_num_threads():
+    """Test that searching on several threads finds the same discriminant"""
+    discriminant_challenge = secrets.token_bytes(10)
+    discriminant = create_discriminant(discriminant_challenge, 1024)
+    for num_threads in (0, 2, 4, 10000):
+        assert create_discriminant(discriminant_challenge, 1024, num_threads) == discriminant
+    with pytest.raises(ValueError, match="num_threads must not be negative"):
+        create_discriminant(discriminant_challenge, 1024, -1)